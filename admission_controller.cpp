@@ -0,0 +1,82 @@
+#include "admission_controller.h"
+
+#include <algorithm>
+
+AdmissionController::Ticket::Ticket(std::shared_ptr<AdmissionController> controller, size_t units)
+  : controller_(std::move(controller)),
+    units_(units),
+    admissionTime_(std::chrono::steady_clock::now())
+{
+}
+
+AdmissionController::Ticket::~Ticket()
+{
+  controller_->release(units_, started_);
+}
+
+std::chrono::microseconds AdmissionController::Ticket::start()
+{
+  const auto wait = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - admissionTime_);
+  if (!started_)
+  {
+    started_ = true;
+    controller_->recordStart(wait);
+  }
+  return wait;
+}
+
+AdmissionController::AdmissionController(size_t capacity)
+{
+  statistics_.capacity = capacity;
+}
+
+std::shared_ptr<AdmissionController::Ticket> AdmissionController::tryAdmit(size_t units)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const bool fits = statistics_.capacity == 0
+        || statistics_.requests == 0
+        || units <= statistics_.capacity - std::min(statistics_.units, statistics_.capacity);
+    if (closed_ || !fits)
+    {
+      ++statistics_.rejected;
+      return nullptr;
+    }
+
+    statistics_.units += units;
+    ++statistics_.requests;
+    ++statistics_.waiting;
+    ++statistics_.admitted;
+  }
+  return std::shared_ptr<Ticket>(new Ticket(shared_from_this(), units));
+}
+
+void AdmissionController::close()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  closed_ = true;
+}
+
+AdmissionController::Statistics AdmissionController::statistics() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+void AdmissionController::release(size_t units, bool started)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  statistics_.units -= units;
+  --statistics_.requests;
+  if (!started)
+    --statistics_.waiting;
+}
+
+void AdmissionController::recordStart(std::chrono::microseconds wait)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  --statistics_.waiting;
+  statistics_.totalWait += wait;
+  statistics_.maxWait = std::max(statistics_.maxWait, wait);
+}
@@ -0,0 +1,68 @@
+#ifndef ADMISSION_CONTROLLER_H
+#define ADMISSION_CONTROLLER_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Bounds the lemmatization work that has been accepted but not finished yet, in estimated work
+// units (request body bytes), so that under overload new requests are turned away at once
+// instead of queueing until all of them are late.
+class AdmissionController : public std::enable_shared_from_this<AdmissionController>
+{
+public:
+  struct Statistics
+  {
+    size_t capacity = 0;
+    size_t units = 0;
+    size_t requests = 0;
+    // Admitted but not started yet.
+    size_t waiting = 0;
+    uint64_t admitted = 0;
+    uint64_t rejected = 0;
+    std::chrono::microseconds totalWait {0};
+    std::chrono::microseconds maxWait {0};
+  };
+
+  // Held from admission until the request is done; gives its units back when destroyed.
+  class Ticket
+  {
+  public:
+    ~Ticket();
+    Ticket(const Ticket&) = delete;
+    Ticket& operator=(const Ticket&) = delete;
+
+    // To be called when the work starts; returns how long the request waited for it.
+    std::chrono::microseconds start();
+
+  private:
+    friend class AdmissionController;
+    Ticket(std::shared_ptr<AdmissionController> controller, size_t units);
+
+    std::shared_ptr<AdmissionController> controller_;
+    size_t units_;
+    std::chrono::steady_clock::time_point admissionTime_;
+    bool started_ = false;
+  };
+
+  // A capacity of 0 admits everything, but still keeps the statistics.
+  explicit AdmissionController(size_t capacity);
+
+  // Null if the units don't fit or the controller is closed. A request is admitted whenever
+  // nothing else is, so that one larger than the whole capacity isn't refused forever.
+  std::shared_ptr<Ticket> tryAdmit(size_t units);
+  // Refuses every request from now on, so that the admitted ones can be drained.
+  void close();
+  Statistics statistics() const;
+
+private:
+  void release(size_t units, bool started);
+  void recordStart(std::chrono::microseconds wait);
+
+  mutable std::mutex mutex_;
+  Statistics statistics_;
+  bool closed_ = false;
+};
+
+#endif // ADMISSION_CONTROLLER_H
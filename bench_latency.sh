@@ -0,0 +1,28 @@
+#!/bin/bash
+# Compares the request latency over loopback TCP and over the Unix domain socket, for a server
+# started with e.g. --unix-socket /tmp/polem.sock.
+#   ./bench_latency.sh [requests] [socket path] [input file]
+requests=${1:-200}
+socket=${2:-/tmp/polem.sock}
+input=${3:-./data/test_input.json}
+
+measure()
+{
+  for ((i = 0; i < requests; ++i)); do
+    curl --silent --output /dev/null --write-out "%{http_code} %{time_total}\n" "$@" \
+      --data-binary "@$input" \
+      --request "POST" \
+      --header "Content-Type: application/json"
+  done | sort -k2,2n | awk -v name="$name" '
+    function percentile(p,    rank) { rank = int(count * p) + 1; if (rank > count) rank = count; return times[rank] }
+    $1 == "000" { ++failed; next }
+    { times[++count] = $2 * 1000; sum += $2 * 1000 }
+    END {
+      if (count == 0) { print name ": no responses"; exit 1 }
+      printf "%-5s %5d requests  mean %7.2f ms  p50 %7.2f ms  p99 %7.2f ms  %d failed\n", name,
+             count, sum / count, percentile(0.5), percentile(0.99), failed
+    }'
+}
+
+name=tcp measure --url http://localhost:5000/v1/lemmatize
+name=unix measure --unix-socket "$socket" --url http://localhost/v1/lemmatize
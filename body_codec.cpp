@@ -0,0 +1,337 @@
+#include "body_codec.h"
+
+#include <algorithm>
+#include <climits>
+#include <map>
+
+#include <zlib.h>
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "content_negotiation.h"
+
+namespace body_codec
+{
+
+namespace
+{
+
+const size_t outputBufferBytes = 16*1024;
+
+// zlib counts in uInt, so larger inputs are fed to it in slices.
+uInt sliceSize(size_t size)
+{
+  return static_cast<uInt>(std::min<size_t>(size, UINT_MAX));
+}
+
+void appendDecoded(std::string& output, const char* data, size_t size, size_t maxDecodedBytes)
+{
+  if (output.size() + size > maxDecodedBytes)
+    throw DecodedBodyTooLarge("Decoded request body exceeds " + std::to_string(maxDecodedBytes)
+                              + " bytes");
+  output.append(data, size);
+}
+
+class GzipEncoder : public Encoder
+{
+public:
+  explicit GzipEncoder(int level)
+    : output_(outputBufferBytes, '\0')
+  {
+    // 16 added to the window bits selects the gzip wrapper instead of zlib's.
+    if (deflateInit2(&stream_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      throw std::runtime_error("Failed to initialise the gzip compressor");
+  }
+
+  ~GzipEncoder() override
+  {
+    deflateEnd(&stream_);
+  }
+
+  void write(std::string_view data, const Sink& sink) override
+  {
+    while (!data.empty())
+    {
+      const uInt slice = sliceSize(data.size());
+      stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+      stream_.avail_in = slice;
+      do
+        deflateInto(Z_NO_FLUSH, sink);
+      while (stream_.avail_in > 0);
+      data.remove_prefix(slice);
+    }
+  }
+
+  void flush(const Sink& sink) override
+  {
+    stream_.next_in = nullptr;
+    stream_.avail_in = 0;
+    // A full output buffer means deflate may have more to give.
+    do
+      deflateInto(Z_SYNC_FLUSH, sink);
+    while (stream_.avail_out == 0);
+  }
+
+  void finish(const Sink& sink) override
+  {
+    stream_.next_in = nullptr;
+    stream_.avail_in = 0;
+    while (deflateInto(Z_FINISH, sink) != Z_STREAM_END)
+    {
+    }
+  }
+
+private:
+  int deflateInto(int flush, const Sink& sink)
+  {
+    stream_.next_out = reinterpret_cast<Bytef*>(output_.data());
+    stream_.avail_out = static_cast<uInt>(output_.size());
+    const int result = deflate(&stream_, flush);
+    if (result == Z_STREAM_ERROR)
+      throw std::runtime_error("gzip compression failed");
+
+    const size_t produced = output_.size() - stream_.avail_out;
+    if (produced > 0)
+      sink(std::string_view(output_.data(), produced));
+    return result;
+  }
+
+  z_stream stream_ {};
+  std::string output_;
+};
+
+std::string decodeGzip(std::string_view input, size_t maxDecodedBytes)
+{
+  z_stream stream {};
+  // 32 added to the window bits accepts both gzip and zlib wrappers.
+  if (inflateInit2(&stream, 15 + 32) != Z_OK)
+    throw std::runtime_error("Failed to initialise the gzip decompressor");
+
+  std::string output;
+  std::string buffer(outputBufferBytes, '\0');
+  bool streamEnded = false;
+  try
+  {
+    while (!input.empty() || !streamEnded)
+    {
+      const uInt slice = sliceSize(input.size());
+      stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+      stream.avail_in = slice;
+      stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+      stream.avail_out = static_cast<uInt>(buffer.size());
+
+      const int result = inflate(&stream, Z_NO_FLUSH);
+      if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+        throw std::runtime_error("Corrupt gzip request body");
+
+      const size_t consumed = slice - stream.avail_in;
+      const size_t produced = buffer.size() - stream.avail_out;
+      input.remove_prefix(consumed);
+      appendDecoded(output, buffer.data(), produced, maxDecodedBytes);
+
+      streamEnded = result == Z_STREAM_END;
+      if (streamEnded && !input.empty())
+      {
+        // Concatenated gzip members decode to the concatenation of their contents.
+        inflateReset(&stream);
+        streamEnded = false;
+      }
+      else if (!streamEnded && consumed == 0 && produced == 0)
+      {
+        throw std::runtime_error("Truncated gzip request body");
+      }
+    }
+  }
+  catch (...)
+  {
+    inflateEnd(&stream);
+    throw;
+  }
+
+  inflateEnd(&stream);
+  return output;
+}
+
+#ifdef WITH_ZSTD
+class ZstdEncoder : public Encoder
+{
+public:
+  explicit ZstdEncoder(int level)
+    : context_(ZSTD_createCCtx()), output_(ZSTD_CStreamOutSize(), '\0')
+  {
+    if (!context_)
+      throw std::runtime_error("Failed to initialise the zstd compressor");
+    ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, level);
+  }
+
+  ~ZstdEncoder() override
+  {
+    ZSTD_freeCCtx(context_);
+  }
+
+  void write(std::string_view data, const Sink& sink) override
+  {
+    ZSTD_inBuffer input {data.data(), data.size(), 0};
+    while (input.pos < input.size)
+      compressInto(input, ZSTD_e_continue, sink);
+  }
+
+  void flush(const Sink& sink) override
+  {
+    ZSTD_inBuffer input {nullptr, 0, 0};
+    while (compressInto(input, ZSTD_e_flush, sink) != 0)
+    {
+    }
+  }
+
+  void finish(const Sink& sink) override
+  {
+    ZSTD_inBuffer input {nullptr, 0, 0};
+    while (compressInto(input, ZSTD_e_end, sink) != 0)
+    {
+    }
+  }
+
+private:
+  size_t compressInto(ZSTD_inBuffer& input, ZSTD_EndDirective directive, const Sink& sink)
+  {
+    ZSTD_outBuffer output {output_.data(), output_.size(), 0};
+    const size_t remaining = ZSTD_compressStream2(context_, &output, &input, directive);
+    if (ZSTD_isError(remaining))
+      throw std::runtime_error(std::string("zstd compression failed: ")
+                               + ZSTD_getErrorName(remaining));
+
+    if (output.pos > 0)
+      sink(std::string_view(output_.data(), output.pos));
+    return remaining;
+  }
+
+  ZSTD_CCtx* context_;
+  std::string output_;
+};
+
+std::string decodeZstd(std::string_view data, size_t maxDecodedBytes)
+{
+  std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+  if (!context)
+    throw std::runtime_error("Failed to initialise the zstd decompressor");
+
+  std::string output;
+  std::string buffer(ZSTD_DStreamOutSize(), '\0');
+  ZSTD_inBuffer input {data.data(), data.size(), 0};
+  size_t frameRemainder = 0;
+  do
+  {
+    ZSTD_outBuffer decoded {buffer.data(), buffer.size(), 0};
+    frameRemainder = ZSTD_decompressStream(context.get(), &decoded, &input);
+    if (ZSTD_isError(frameRemainder))
+      throw std::runtime_error(std::string("Corrupt zstd request body: ")
+                               + ZSTD_getErrorName(frameRemainder));
+
+    appendDecoded(output, buffer.data(), decoded.pos, maxDecodedBytes);
+    if (decoded.pos == 0 && input.pos == input.size && frameRemainder != 0)
+      throw std::runtime_error("Truncated zstd request body");
+  }
+  while (input.pos < input.size || frameRemainder != 0);
+
+  return output;
+}
+#endif
+
+}
+
+std::optional<Encoding> parseEncoding(const std::string& name)
+{
+  if (name.empty() || content_negotiation::equalsIgnoringCase(name, "identity"))
+    return Encoding::Identity;
+  if (content_negotiation::equalsIgnoringCase(name, "gzip")
+      || content_negotiation::equalsIgnoringCase(name, "x-gzip"))
+    return Encoding::Gzip;
+#ifdef WITH_ZSTD
+  if (content_negotiation::equalsIgnoringCase(name, "zstd"))
+    return Encoding::Zstd;
+#endif
+  return std::nullopt;
+}
+
+std::string encodingName(Encoding encoding)
+{
+  switch (encoding)
+  {
+    case Encoding::Gzip:
+      return "gzip";
+    case Encoding::Zstd:
+      return "zstd";
+    default:
+      return "identity";
+  }
+}
+
+Encoding selectResponseEncoding(const std::string& acceptEncoding)
+{
+  std::map<std::string, double> qualities;
+  for (const auto& entry : content_negotiation::parseAcceptList(acceptEncoding))
+    qualities[entry.value == "x-gzip" ? "gzip" : entry.value] = entry.quality;
+
+  const auto wildcard = qualities.find("*");
+  const double wildcardQuality = wildcard == qualities.end() ? 0.0 : wildcard->second;
+
+  Encoding selected = Encoding::Identity;
+  double selectedQuality = 0.0;
+  for (const auto candidate : {Encoding::Zstd, Encoding::Gzip})
+  {
+    const auto name = encodingName(candidate);
+    if (!parseEncoding(name))
+      continue;
+
+    const auto quality = qualities.find(name);
+    const double candidateQuality = quality == qualities.end() ? wildcardQuality : quality->second;
+    if (candidateQuality > selectedQuality)
+    {
+      selected = candidate;
+      selectedQuality = candidateQuality;
+    }
+  }
+  return selected;
+}
+
+std::string decode(Encoding encoding, std::string_view input, size_t maxDecodedBytes)
+{
+  switch (encoding)
+  {
+    case Encoding::Gzip:
+      return decodeGzip(input, maxDecodedBytes);
+#ifdef WITH_ZSTD
+    case Encoding::Zstd:
+      return decodeZstd(input, maxDecodedBytes);
+#endif
+    case Encoding::Identity:
+    {
+      std::string output;
+      appendDecoded(output, input.data(), input.size(), maxDecodedBytes);
+      return output;
+    }
+    default:
+      throw std::runtime_error("Unsupported content encoding " + encodingName(encoding));
+  }
+}
+
+std::unique_ptr<Encoder> makeEncoder(Encoding encoding, const CompressionSettings& settings)
+{
+  switch (encoding)
+  {
+    case Encoding::Gzip:
+      return std::make_unique<GzipEncoder>(settings.gzipLevel);
+#ifdef WITH_ZSTD
+    case Encoding::Zstd:
+      return std::make_unique<ZstdEncoder>(settings.zstdLevel);
+#endif
+    case Encoding::Identity:
+      return nullptr;
+    default:
+      throw std::runtime_error("Unsupported content encoding " + encodingName(encoding));
+  }
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef BODY_CODEC_H
+#define BODY_CODEC_H
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// HTTP content codings for request and response bodies. gzip is always available; zstd only when
+// built with WITH_ZSTD (qmake CONFIG+=with_zstd).
+namespace body_codec
+{
+
+enum class Encoding
+{
+  Identity,
+  Gzip,
+  Zstd
+};
+
+using Sink = std::function<void(std::string_view)>;
+
+// Thrown by decode() when the decoded body would exceed its size limit.
+class DecodedBodyTooLarge : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+// Compresses a body piece by piece; the output is handed to the sink as soon as the compressor
+// produces it, so neither the input nor the output has to be held in full.
+class Encoder
+{
+public:
+  virtual ~Encoder() = default;
+
+  virtual void write(std::string_view data, const Sink& sink) = 0;
+  // Emits everything written so far in a form the client can decode, without ending the stream.
+  virtual void flush(const Sink& sink) = 0;
+  // Flushes what the compressor still holds and ends the stream.
+  virtual void finish(const Sink& sink) = 0;
+};
+
+struct CompressionSettings
+{
+  int gzipLevel = 6;
+  int zstdLevel = 3;
+  // Responses smaller than this are sent uncompressed; compressing them costs more than it saves.
+  size_t minBytes = 1024;
+};
+
+// Content-Encoding name to encoding; std::nullopt for codings this build can't handle.
+std::optional<Encoding> parseEncoding(const std::string& name);
+std::string encodingName(Encoding encoding);
+
+// Best encoding this build supports among those an Accept-Encoding value allows; zstd wins ties.
+Encoding selectResponseEncoding(const std::string& acceptEncoding);
+
+// Throws std::runtime_error if the input is corrupt or truncated and DecodedBodyTooLarge if it
+// decodes to more than `maxDecodedBytes`.
+std::string decode(Encoding encoding, std::string_view input, size_t maxDecodedBytes);
+
+// nullptr for Encoding::Identity.
+std::unique_ptr<Encoder> makeEncoder(Encoding encoding, const CompressionSettings& settings);
+
+}
+
+#endif // BODY_CODEC_H
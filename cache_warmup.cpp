@@ -0,0 +1,112 @@
+#include "cache_warmup.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+#include "disk_input.h"
+#include "label_processing.h"
+#include "lemmatizer_pool.h"
+
+namespace cache_warmup
+{
+
+namespace
+{
+
+void appendDocs(const Json& corpusJson, std::vector<Json>& docs)
+{
+  if (!corpusJson.is_object())
+    return;
+
+  if (!corpusJson.contains(key_names::docsKey))
+  {
+    docs.push_back(corpusJson);
+    return;
+  }
+
+  const Json& corpusDocs = corpusJson.at(key_names::docsKey);
+  if (corpusDocs.is_array())
+    docs.insert(docs.end(), corpusDocs.begin(), corpusDocs.end());
+}
+
+std::vector<Json> loadCorpusDocs(const std::vector<fs::path>& corpusPaths)
+{
+  std::vector<Json> docs;
+  for (const auto& corpusPath : corpusPaths)
+  {
+    try
+    {
+      if (corpusPath.extension() == ".json")
+      {
+        appendDocs(readJsonFromDisk(corpusPath), docs);
+        continue;
+      }
+
+      for (const auto& jsonLine : readJsonLinesFromDisk(corpusPath))
+        appendDocs(jsonLine, docs);
+    }
+    catch (const std::exception& exception)
+    {
+      std::cout << "> Skipping warm-up corpus " << corpusPath << ": " << exception.what() << "\n";
+    }
+  }
+  return docs;
+}
+
+}
+
+Summary warmUp(const std::vector<fs::path>& corpusPaths,
+               LemmatizerPool& lemmatizerPool,
+               LemmaCache* lemmaCache,
+               size_t threadCount,
+               std::chrono::milliseconds timeBudget)
+{
+  const auto deadline = std::chrono::steady_clock::now() + timeBudget;
+  const std::vector<Json> docs = loadCorpusDocs(corpusPaths);
+
+  std::atomic<size_t> nextDoc {0};
+  std::atomic<size_t> processedDocs {0};
+  std::atomic<bool> timedOut {false};
+  auto processDocs = [&]()
+  {
+    auto lemmatizer = lemmatizerPool.acquire();
+    for (size_t docIndex = nextDoc++; docIndex < docs.size(); docIndex = nextDoc++)
+    {
+      if (std::chrono::steady_clock::now() >= deadline)
+      {
+        timedOut = true;
+        return;
+      }
+
+      Json singleDocJson = {{key_names::docsKey, Json::array({docs[docIndex]})}};
+      try
+      {
+        label_processing::findAndLemmatizeNerLabelsInJson(singleDocJson, *lemmatizer, lemmaCache);
+        ++processedDocs;
+      }
+      catch (const std::exception&)
+      {
+      }
+    }
+  };
+
+  // Every thread holds a lemmatizer throughout, so more threads than the pool has lemmatizers
+  // would only wait for the others to finish.
+  const size_t lemmatizerCount = std::max<size_t>(lemmatizerPool.statistics().capacity, 1);
+  const size_t workerCount = std::clamp<size_t>(threadCount, 1, lemmatizerCount);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < workerCount; ++i)
+    workers.emplace_back(processDocs);
+  for (auto& worker : workers)
+    worker.join();
+
+  Summary summary;
+  summary.loadedDocs = docs.size();
+  summary.processedDocs = processedDocs;
+  summary.timedOut = timedOut;
+  return summary;
+}
+
+}
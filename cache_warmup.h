@@ -0,0 +1,32 @@
+#ifndef CACHE_WARMUP_H
+#define CACHE_WARMUP_H
+
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+class LemmaCache;
+class LemmatizerPool;
+
+namespace cache_warmup
+{
+
+struct Summary
+{
+  size_t loadedDocs = 0;
+  size_t processedDocs = 0;
+  bool timedOut = false;
+};
+
+// Runs the docs of the given .json/.jsonl corpora through the regular lemmatization path on
+// `threadCount` threads, filling the lemma cache and faulting in Polem's dictionary pages.
+// Gives up on the remaining docs once `timeBudget` has passed.
+Summary warmUp(const std::vector<std::filesystem::path>& corpusPaths,
+               LemmatizerPool& lemmatizerPool,
+               LemmaCache* lemmaCache,
+               size_t threadCount,
+               std::chrono::milliseconds timeBudget);
+
+}
+
+#endif // CACHE_WARMUP_H
@@ -0,0 +1,115 @@
+#include "content_negotiation.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace content_negotiation
+{
+
+namespace
+{
+
+std::string trim(const std::string& text)
+{
+  const auto begin = text.find_first_not_of(" \t");
+  if (begin == std::string::npos)
+    return {};
+  const auto end = text.find_last_not_of(" \t");
+  return text.substr(begin, end - begin + 1);
+}
+
+std::string toLowercase(std::string text)
+{
+  std::transform(text.begin(), text.end(), text.begin(), [](unsigned char character)
+  {
+    return std::tolower(character);
+  });
+  return text;
+}
+
+std::vector<std::string> split(const std::string& text, char separator)
+{
+  std::vector<std::string> parts;
+  size_t partStart = 0;
+  for (;;)
+  {
+    const auto partEnd = text.find(separator, partStart);
+    parts.push_back(text.substr(partStart, partEnd - partStart));
+    if (partEnd == std::string::npos)
+      return parts;
+    partStart = partEnd + 1;
+  }
+}
+
+std::string unquote(const std::string& text)
+{
+  if (text.size() >= 2 && text.front() == '"' && text.back() == '"')
+    return text.substr(1, text.size() - 2);
+  return text;
+}
+
+}
+
+std::vector<AcceptEntry> parseAcceptList(const std::string& headerValue)
+{
+  std::vector<AcceptEntry> entries;
+  for (const auto& element : split(headerValue, ','))
+  {
+    const auto fields = split(element, ';');
+    AcceptEntry entry;
+    entry.value = toLowercase(trim(fields.front()));
+    if (entry.value.empty())
+      continue;
+
+    for (size_t field = 1; field < fields.size(); ++field)
+    {
+      const auto separator = fields[field].find('=');
+      const auto name = toLowercase(trim(fields[field].substr(0, separator)));
+      const auto value = separator == std::string::npos
+          ? std::string()
+          : unquote(trim(fields[field].substr(separator + 1)));
+      if (name.empty())
+        continue;
+
+      if (name == "q")
+        entry.quality = std::clamp(std::strtod(value.c_str(), nullptr), 0.0, 1.0);
+      else
+        entry.parameters[name] = value;
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+std::optional<std::string> findMediaTypeParameter(const std::string& headerValue,
+                                                  const std::string& mediaType,
+                                                  const std::string& parameter)
+{
+  for (const auto& entry : parseAcceptList(headerValue))
+  {
+    if (entry.value != mediaType)
+      continue;
+
+    const auto value = entry.parameters.find(toLowercase(parameter));
+    if (value == entry.parameters.end())
+      return std::nullopt;
+    return value->second;
+  }
+  return std::nullopt;
+}
+
+bool equalsIgnoringCase(const std::string& left, const std::string& right)
+{
+  return std::equal(left.begin(), left.end(), right.begin(), right.end(), [](char l, char r)
+  {
+    return std::tolower(static_cast<unsigned char>(l)) == std::tolower(static_cast<unsigned char>(r));
+  });
+}
+
+bool isFlagEnabled(const std::optional<std::string>& flag)
+{
+  return flag && (flag->empty() || *flag == "1" || equalsIgnoringCase(*flag, "true"));
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef CONTENT_NEGOTIATION_H
+#define CONTENT_NEGOTIATION_H
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace content_negotiation
+{
+
+// One element of an Accept-style header, e.g. `application/json; compact=true; q=0.5` or `gzip`.
+struct AcceptEntry
+{
+  std::string value;
+  std::map<std::string, std::string> parameters;
+  double quality = 1.0;
+};
+
+// Splits an Accept, Accept-Encoding or Content-Type value into its elements. Values and parameter
+// names are lowercased, parameter values are kept as they are (without quotes); "q" is moved to
+// `quality`.
+std::vector<AcceptEntry> parseAcceptList(const std::string& headerValue);
+
+// Parameter of the first element accepting `mediaType` by its exact name, e.g. the `compact` in
+// `Accept: application/json; compact=true`.
+std::optional<std::string> findMediaTypeParameter(const std::string& headerValue,
+                                                  const std::string& mediaType,
+                                                  const std::string& parameter);
+
+bool equalsIgnoringCase(const std::string& left, const std::string& right);
+
+// Interprets the value of a boolean query parameter or media type parameter; a flag given
+// without a value counts as enabled.
+bool isFlagEnabled(const std::optional<std::string>& flag);
+
+}
+
+#endif // CONTENT_NEGOTIATION_H
@@ -1,6 +1,6 @@
 #!/bin/bash
 curl \
---url http://localhost:5000/ \
+--url http://localhost:5000/v1/lemmatize \
 --data-binary "@./data/test_input.json" \
 --request "POST" \
 --header "Content-Type: application/json" \
@@ -0,0 +1,53 @@
+#include "dictionary_prefetch.h"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace dictionary_prefetch
+{
+
+namespace
+{
+
+uintmax_t prefetchFile(const fs::path& path)
+{
+  // Before the open, as it may throw and the descriptor would leak.
+  const auto fileSize = fs::file_size(path);
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error("Failed to open file " + path.string());
+
+  const int result = ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  ::close(fd);
+
+  if (result != 0)
+    throw std::runtime_error("Failed to prefetch file " + path.string());
+
+  return fileSize;
+}
+
+}
+
+uintmax_t prefetchIntoPageCache(const fs::path& path)
+{
+  if (!fs::exists(path))
+    throw std::invalid_argument("Path " + path.string() + " doesn't exist");
+
+  if (!fs::is_directory(path))
+    return prefetchFile(path);
+
+  uintmax_t prefetchedBytes = 0;
+  for (const auto& entry : fs::recursive_directory_iterator(path))
+  {
+    if (entry.is_regular_file())
+      prefetchedBytes += prefetchFile(entry.path());
+  }
+
+  return prefetchedBytes;
+}
+
+}
@@ -0,0 +1,16 @@
+#ifndef DICTIONARY_PREFETCH_H
+#define DICTIONARY_PREFETCH_H
+
+#include <cstdint>
+#include <filesystem>
+
+namespace dictionary_prefetch
+{
+
+// Asks the kernel to read the given file, or every regular file under the given directory,
+// into the page cache. Returns the number of bytes scheduled for readahead.
+uintmax_t prefetchIntoPageCache(const std::filesystem::path& path);
+
+}
+
+#endif // DICTIONARY_PREFETCH_H
@@ -4,13 +4,15 @@
 #include <filesystem>
 #include <fstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "nlohmann_json/json.hpp"
 
 using Json = nlohmann::json;
 namespace fs = std::filesystem;
 
-Json readJsonFromDisk(const fs::path& path)
+inline Json readJsonFromDisk(const fs::path& path)
 {
   if (!fs::exists(path))
     throw std::invalid_argument("File doesn't exist");
@@ -30,4 +32,28 @@ Json readJsonFromDisk(const fs::path& path)
   return json;
 }
 
+inline std::vector<Json> readJsonLinesFromDisk(const fs::path& path)
+{
+  if (!fs::exists(path))
+    throw std::invalid_argument("File doesn't exist");
+  if (path.extension() != ".jsonl" && path.extension() != ".ndjson")
+    throw std::invalid_argument("File is not of .jsonl type");
+
+  std::ifstream jsonFile(path, std::ifstream::in);
+
+  if (!jsonFile.good())
+    throw std::runtime_error("Failed to open file " + path.string());
+
+  std::vector<Json> jsonLines;
+  std::string line;
+  while (std::getline(jsonFile, line))
+  {
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+    jsonLines.push_back(Json::parse(line));
+  }
+
+  return jsonLines;
+}
+
 #endif // DISK_INPUT_H
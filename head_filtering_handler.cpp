@@ -0,0 +1,108 @@
+#include "head_filtering_handler.h"
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include <sys/socket.h>
+
+#include "rest_request_handler.h"
+
+using namespace Pistache;
+
+namespace
+{
+
+Async::Promise<ssize_t> sendRaw(Tcp::Peer& peer, std::string data)
+{
+  const auto size = data.size();
+  return peer.send(RawBuffer(std::move(data), size));
+}
+
+}
+
+HeadFilteringHandler::HeadFilteringHandler(std::shared_ptr<RestRequestHandler> handler)
+  : handler_(std::move(handler))
+{
+}
+
+HeadFilteringHandler::HeadFilteringHandler(const HeadFilteringHandler& other)
+  : Http::Handler(other),
+    handler_(std::make_shared<RestRequestHandler>(*other.handler_))
+{
+}
+
+void HeadFilteringHandler::onRequest(const Http::Request& request, Http::ResponseWriter response)
+{
+  handler_->onRequest(request, std::move(response));
+}
+
+void HeadFilteringHandler::onConnection(const std::shared_ptr<Tcp::Peer>& peer)
+{
+  // Pistache associates only this handler with the I/O thread's transport, after cloning it.
+  // The wrapped handler writes its responses through the transport it holds, so it's copied
+  // once more with this handler's Pistache part, transport and size limits included.
+  if (!connected_)
+  {
+    handler_ = std::make_shared<RestRequestHandler>(*handler_, *this);
+    connected_ = true;
+  }
+  headFilters_.emplace(peer->fd(), handler_->makeHeadFilter());
+  wrappedHandler().onConnection(peer);
+}
+
+void HeadFilteringHandler::onInput(const char* buffer, size_t length,
+                                   const std::shared_ptr<Tcp::Peer>& peer)
+{
+  auto filter = headFilters_.find(peer->fd());
+  if (filter == headFilters_.end())
+    filter = headFilters_.emplace(peer->fd(), handler_->makeHeadFilter()).first;
+
+  const auto verdict = filter->second.consume(std::string_view(buffer, length));
+  switch (verdict.action)
+  {
+    case RequestHeadFilter::Action::Pass:
+      break;
+
+    case RequestHeadFilter::Action::PassAndContinue:
+      // Queued behind any response still being written on this connection, like every send.
+      sendRaw(*peer, RequestHeadFilter::continueResponse());
+      break;
+
+    case RequestHeadFilter::Action::Reject:
+    {
+      std::cout << "> Request Rejected before its body: " << verdict.rejection.message;
+      // Requests pipelined ahead of the rejected one are still parsed and answered.
+      if (verdict.passedBytes > 0)
+        wrappedHandler().onInput(buffer, verdict.passedBytes, peer);
+      // The connection is closed once the response is out, rather than reading and dropping a
+      // body that may be large.
+      const std::weak_ptr<Tcp::Peer> weakPeer = peer;
+      sendRaw(*peer, RequestHeadFilter::rejectionResponse(verdict.rejection)).then(
+            [weakPeer](ssize_t)
+            {
+              if (const auto peer = weakPeer.lock())
+                ::shutdown(peer->fd(), SHUT_RDWR);
+            },
+            Async::IgnoreException);
+      return;
+    }
+
+    case RequestHeadFilter::Action::Discard:
+      return;
+  }
+
+  wrappedHandler().onInput(buffer, length, peer);
+}
+
+void HeadFilteringHandler::onDisconnection(const std::shared_ptr<Tcp::Peer>& peer)
+{
+  headFilters_.erase(peer->fd());
+  wrappedHandler().onDisconnection(peer);
+}
+
+Tcp::Handler& HeadFilteringHandler::wrappedHandler()
+{
+  // Through the base, where these are public; the calls still go to Http::Handler's parser.
+  return *handler_;
+}
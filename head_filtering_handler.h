@@ -0,0 +1,50 @@
+#ifndef HEAD_FILTERING_HANDLER_H
+#define HEAD_FILTERING_HANDLER_H
+
+#include <memory>
+#include <unordered_map>
+
+#include <pistache/endpoint.h>
+
+#include "request_head_filter.h"
+
+class RestRequestHandler;
+
+// The handler Pistache delivers the connections to. It sees the bytes of every connection
+// first, judges each request by its head before Pistache buffers the body, and hands the bytes
+// of the accepted requests to the HTTP parser of the RestRequestHandler it wraps.
+//
+// Pistache keeps Http::Handler's own onInput private, so a handler can't filter the input and
+// still call the parser itself; the wrapped handler is reached through the Tcp::Handler
+// interface instead, the way the transport calls it.
+class HeadFilteringHandler : public Pistache::Http::Handler
+{
+public:
+  HTTP_PROTOTYPE(HeadFilteringHandler)
+
+  explicit HeadFilteringHandler(std::shared_ptr<RestRequestHandler> handler);
+  // Every I/O thread gets a copy, with a copy of the wrapped handler.
+  HeadFilteringHandler(const HeadFilteringHandler& other);
+  HeadFilteringHandler& operator=(const HeadFilteringHandler&) = delete;
+
+  // Requests are parsed and answered by the wrapped handler; this only forwards to it.
+  void onRequest(const Pistache::Http::Request& request,
+                 Pistache::Http::ResponseWriter response) override;
+
+private:
+  void onConnection(const std::shared_ptr<Pistache::Tcp::Peer>& peer) override;
+  void onInput(const char* buffer, size_t length,
+               const std::shared_ptr<Pistache::Tcp::Peer>& peer) override;
+  void onDisconnection(const std::shared_ptr<Pistache::Tcp::Peer>& peer) override;
+
+  Pistache::Tcp::Handler& wrappedHandler();
+
+  std::shared_ptr<RestRequestHandler> handler_;
+  // Whether handler_ has been given this handler's transport.
+  bool connected_ = false;
+  // By socket. Every clone of the handler serves the connections of one I/O thread, so this
+  // needs no locking.
+  std::unordered_map<int, RequestHeadFilter> headFilters_;
+};
+
+#endif // HEAD_FILTERING_HANDLER_H
@@ -0,0 +1,318 @@
+#include "job_manager.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "lemmatizer_pool.h"
+#include "ndjson_processing.h"
+#include "service_state.h"
+
+namespace
+{
+
+const std::string inputSuffix = ".input.ndjson";
+const std::string resultSuffix = ".result.ndjson";
+const std::string partialResultSuffix = ".result.ndjson.part";
+
+bool endsWith(const std::string& text, const std::string& suffix)
+{
+  return text.size() >= suffix.size()
+      && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string makeJobId()
+{
+  std::random_device randomDevice;
+  std::ostringstream id;
+  id << std::hex << std::setfill('0');
+  for (int i = 0; i < 4; ++i)
+    id << std::setw(8) << static_cast<uint32_t>(randomDevice());
+  return id.str();
+}
+
+}
+
+JobManager::JobManager(std::filesystem::path directory,
+                       size_t threadCount,
+                       std::chrono::steady_clock::duration retention,
+                       std::shared_ptr<ServiceState> state)
+  : directory_(std::move(directory)),
+    retention_(retention),
+    state_(std::move(state)),
+    pool_(threadCount)
+{
+  std::filesystem::create_directories(directory_);
+  removeFilesOfEarlierRuns();
+}
+
+JobManager::~JobManager()
+{
+  stopping_ = true;
+}
+
+std::string JobManager::submit(std::string_view input)
+{
+  removeExpiredJobs();
+
+  auto job = std::make_shared<Job>();
+  job->id = makeJobId();
+  job->inputBytes = input.size();
+
+  // Written on the calling thread rather than queued with the job, so that memory holds at most
+  // the uploads in flight, not every queued job's input.
+  std::ofstream file(inputPath(job->id), std::ios::binary);
+  file.write(input.data(), static_cast<std::streamsize>(input.size()));
+  file.close();
+  if (!file)
+  {
+    deleteFiles(*job);
+    throw std::runtime_error("Couldn't write the job input to " + inputPath(job->id).string());
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_[job->id] = job;
+  }
+  pool_.submit([this, job]{ run(*job); });
+  return job->id;
+}
+
+std::optional<JobManager::Progress> JobManager::progress(const std::string& id) const
+{
+  std::shared_ptr<Job> job;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto found = jobs_.find(id);
+    if (found == jobs_.end())
+      return std::nullopt;
+    job = found->second;
+  }
+
+  Progress progress;
+  progress.status = job->status;
+  progress.inputBytes = job->inputBytes;
+  progress.processedBytes = job->processedBytes;
+  progress.docs = job->docs;
+  progress.failedLines = job->failedLines;
+  if (progress.status == Status::Failed)
+    progress.error = job->error;
+  return progress;
+}
+
+std::optional<std::filesystem::path> JobManager::resultPath(const std::string& id) const
+{
+  const auto jobProgress = progress(id);
+  if (!jobProgress || jobProgress->status != Status::Done)
+    return std::nullopt;
+  return resultFilePath(id);
+}
+
+bool JobManager::remove(const std::string& id)
+{
+  std::shared_ptr<Job> job;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto found = jobs_.find(id);
+    if (found == jobs_.end())
+      return false;
+    job = found->second;
+    jobs_.erase(found);
+  }
+
+  // A queued or running job deletes its own files once it sees the flag.
+  job->removed = true;
+  const Status status = job->status;
+  if (status == Status::Done || status == Status::Failed)
+    deleteFiles(*job);
+  return true;
+}
+
+std::string JobManager::statusName(Status status)
+{
+  switch (status)
+  {
+    case Status::Queued: return "queued";
+    case Status::Running: return "running";
+    case Status::Done: return "done";
+    case Status::Failed: return "failed";
+  }
+  return "unknown";
+}
+
+void JobManager::removeFilesOfEarlierRuns() const
+{
+  size_t removedCount = 0;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(directory_, error))
+  {
+    const auto name = entry.path().filename().string();
+    if (entry.is_regular_file(error)
+        && (endsWith(name, inputSuffix) || endsWith(name, resultSuffix)
+            || endsWith(name, partialResultSuffix))
+        && std::filesystem::remove(entry.path(), error))
+      ++removedCount;
+  }
+  if (removedCount > 0)
+    std::cout << "> Removed " << removedCount << " job file(s) left in " << directory_ << "\n";
+}
+
+void JobManager::removeExpiredJobs()
+{
+  if (retention_ == std::chrono::steady_clock::duration::zero())
+    return;
+
+  const auto now = std::chrono::steady_clock::now();
+  std::vector<std::shared_ptr<Job>> expiredJobs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto job = jobs_.begin(); job != jobs_.end();)
+    {
+      const Status status = job->second->status;
+      if ((status == Status::Done || status == Status::Failed)
+          && now - job->second->finishTime >= retention_)
+      {
+        expiredJobs.push_back(std::move(job->second));
+        job = jobs_.erase(job);
+      }
+      else
+      {
+        ++job;
+      }
+    }
+  }
+
+  for (const auto& job : expiredJobs)
+  {
+    job->removed = true;
+    deleteFiles(*job);
+    std::cout << "> Job " << job->id << " expired\n";
+  }
+}
+
+void JobManager::run(Job& job)
+{
+  if (job.removed)
+  {
+    deleteFiles(job);
+    return;
+  }
+  if (stopping_)
+  {
+    fail(job, "The server stopped before the job ran");
+    return;
+  }
+
+  job.status = Status::Running;
+  std::cout << "> Job " << job.id << " started, " << job.inputBytes << " bytes\n";
+
+  if (!state_->lemmatizerPool())
+  {
+    fail(job, "The lemmatizer is " + ServiceState::statusName(state_->status()));
+    return;
+  }
+
+  std::ifstream input(inputPath(job.id), std::ios::binary);
+  std::ofstream output(partialResultPath(job.id), std::ios::binary);
+  if (!input || !output)
+  {
+    fail(job, "Couldn't open the job files in " + directory_.string());
+    return;
+  }
+
+  std::string line;
+  std::string outputLine;
+  size_t lineNumber = 0;
+  while (std::getline(input, line))
+  {
+    if (job.removed || stopping_)
+      break;
+
+    ++lineNumber;
+    job.processedBytes += line.size() + 1;
+    if (ndjson_processing::isBlank(line))
+      continue;
+
+    // Taken again for every line rather than held for the whole job, so that a reload can
+    // release the previous pool while a long job runs; a line sees one pool and its cache.
+    std::shared_ptr<LemmaCache> lemmaCache;
+    const auto lemmatizerPool = state_->lemmatizerPool(lemmaCache);
+    if (ndjson_processing::lemmatizeLine(line, lineNumber, *lemmatizerPool,
+                                         lemmaCache.get(), outputLine))
+      ++job.docs;
+    else
+      ++job.failedLines;
+
+    outputLine += '\n';
+    output.write(outputLine.data(), static_cast<std::streamsize>(outputLine.size()));
+  }
+  output.close();
+
+  if (job.removed)
+  {
+    deleteFiles(job);
+    return;
+  }
+  if (stopping_)
+  {
+    fail(job, "The server stopped during the job");
+    return;
+  }
+  if (!output)
+  {
+    fail(job, "Couldn't write the job result to " + directory_.string());
+    return;
+  }
+
+  std::error_code error;
+  std::filesystem::rename(partialResultPath(job.id), resultFilePath(job.id), error);
+  std::filesystem::remove(inputPath(job.id), error);
+  job.processedBytes = job.inputBytes;
+  job.finishTime = std::chrono::steady_clock::now();
+  job.status = Status::Done;
+  std::cout << "> Job " << job.id << " done, " << job.docs << " doc(s), "
+            << job.failedLines << " failed line(s)\n";
+
+  // Removed while finishing.
+  if (job.removed)
+    deleteFiles(job);
+}
+
+void JobManager::fail(Job& job, const std::string& error)
+{
+  std::cout << "> Job " << job.id << " failed: " << error << "\n";
+  job.error = error;
+  job.finishTime = std::chrono::steady_clock::now();
+  job.status = Status::Failed;
+
+  std::error_code removeError;
+  std::filesystem::remove(partialResultPath(job.id), removeError);
+  std::filesystem::remove(inputPath(job.id), removeError);
+}
+
+void JobManager::deleteFiles(const Job& job) const
+{
+  std::error_code error;
+  std::filesystem::remove(inputPath(job.id), error);
+  std::filesystem::remove(partialResultPath(job.id), error);
+  std::filesystem::remove(resultFilePath(job.id), error);
+}
+
+std::filesystem::path JobManager::inputPath(const std::string& id) const
+{
+  return directory_ / (id + inputSuffix);
+}
+
+std::filesystem::path JobManager::resultFilePath(const std::string& id) const
+{
+  return directory_ / (id + resultSuffix);
+}
+
+std::filesystem::path JobManager::partialResultPath(const std::string& id) const
+{
+  return directory_ / (id + partialResultSuffix);
+}
@@ -0,0 +1,103 @@
+#ifndef JOB_MANAGER_H
+#define JOB_MANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "work_stealing_pool.h"
+
+class ServiceState;
+
+// Lemmatization jobs for corpora too large for a request. The NDJSON input is spooled to a
+// directory and processed a line at a time, so memory doesn't grow with the corpus, on threads
+// of its own, so jobs don't take the compute threads from interactive requests. The result is
+// written to a file next to the input. Jobs are known only to the process that ran them, so the
+// files an earlier process left in the directory are removed at startup.
+class JobManager
+{
+public:
+  enum class Status
+  {
+    Queued,
+    Running,
+    Done,
+    Failed
+  };
+
+  struct Progress
+  {
+    Status status = Status::Queued;
+    uint64_t inputBytes = 0;
+    uint64_t processedBytes = 0;
+    uint64_t docs = 0;
+    uint64_t failedLines = 0;
+    std::string error;
+  };
+
+  // Finished jobs are removed with their files `retention` after they finish, once the next job
+  // is submitted; zero keeps them until they are removed.
+  JobManager(std::filesystem::path directory,
+             size_t threadCount,
+             std::chrono::steady_clock::duration retention,
+             std::shared_ptr<ServiceState> state);
+  // Running jobs stop at their next line and queued ones don't start; they are reported failed.
+  ~JobManager();
+  JobManager(const JobManager&) = delete;
+  JobManager& operator=(const JobManager&) = delete;
+
+  // Spools the input and queues the job; returns its id. Throws std::runtime_error if the input
+  // can't be written. Blocks until the input is on disk, so it doesn't belong on an I/O thread.
+  std::string submit(std::string_view input);
+  std::optional<Progress> progress(const std::string& id) const;
+  // The result file of a job that is done.
+  std::optional<std::filesystem::path> resultPath(const std::string& id) const;
+  // Forgets the job and deletes its files; a running job stops at its next line. Returns false
+  // for an unknown job.
+  bool remove(const std::string& id);
+
+  static std::string statusName(Status status);
+
+private:
+  struct Job
+  {
+    std::string id;
+    uint64_t inputBytes = 0;
+    std::atomic<Status> status {Status::Queued};
+    std::atomic<uint64_t> processedBytes {0};
+    std::atomic<uint64_t> docs {0};
+    std::atomic<uint64_t> failedLines {0};
+    std::atomic<bool> removed {false};
+    // Set once, before the status becomes Failed.
+    std::string error;
+    // Set once, before the status becomes Done or Failed.
+    std::chrono::steady_clock::time_point finishTime;
+  };
+
+  void removeFilesOfEarlierRuns() const;
+  void removeExpiredJobs();
+  void run(Job& job);
+  void fail(Job& job, const std::string& error);
+  void deleteFiles(const Job& job) const;
+  std::filesystem::path inputPath(const std::string& id) const;
+  std::filesystem::path resultFilePath(const std::string& id) const;
+  std::filesystem::path partialResultPath(const std::string& id) const;
+
+  const std::filesystem::path directory_;
+  const std::chrono::steady_clock::duration retention_;
+  const std::shared_ptr<ServiceState> state_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<Job>> jobs_;
+  std::atomic<bool> stopping_ {false};
+  // Last, so that it's joined before the rest is destroyed.
+  WorkStealingPool pool_;
+};
+
+#endif // JOB_MANAGER_H
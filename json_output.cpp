@@ -0,0 +1,185 @@
+#include "json_output.h"
+
+#include <cassert>
+#include <string>
+
+#include "label_processing.h"
+
+using Json = nlohmann::json;
+
+namespace json_output
+{
+
+namespace
+{
+
+using wire_format::WireFormat;
+
+void appendBigEndian(std::string& buffer, uint64_t value, size_t bytes)
+{
+  for (size_t byte = bytes; byte > 0; --byte)
+    buffer += static_cast<char>((value >> (8*(byte - 1))) & 0xff);
+}
+
+// Array and map headers in the shortest form, as the library writes them.
+void appendContainerHeader(std::string& buffer, WireFormat format, bool isMap, uint64_t size)
+{
+  if (format == WireFormat::Cbor)
+  {
+    const uint8_t majorType = isMap ? 0xa0 : 0x80;
+    if (size < 24)
+    {
+      buffer += static_cast<char>(majorType + size);
+    }
+    else
+    {
+      const size_t bytes = size <= 0xff ? 1 : size <= 0xffff ? 2 : size <= 0xffffffff ? 4 : 8;
+      const uint8_t lengthType = bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27;
+      buffer += static_cast<char>(majorType + lengthType);
+      appendBigEndian(buffer, size, bytes);
+    }
+    return;
+  }
+
+  if (size < 16)
+  {
+    buffer += static_cast<char>((isMap ? 0x80 : 0x90) | size);
+  }
+  else if (size <= 0xffff)
+  {
+    buffer += static_cast<char>(isMap ? 0xde : 0xdc);
+    appendBigEndian(buffer, size, 2);
+  }
+  else
+  {
+    buffer += static_cast<char>(isMap ? 0xdf : 0xdd);
+    appendBigEndian(buffer, size, 4);
+  }
+}
+
+void appendBinary(std::string& buffer, WireFormat format, const Json& value)
+{
+  if (format == WireFormat::Cbor)
+    Json::to_cbor(value, nlohmann::detail::output_adapter<char>(buffer));
+  else
+    Json::to_msgpack(value, nlohmann::detail::output_adapter<char>(buffer));
+}
+
+}
+
+void serializeByDoc(const Json& json, int indent, const Sink& sink)
+{
+  // The library's own serializer, so that numbers, escaping and indentation come out exactly as
+  // dump() would write them; unlike dump() it appends to a buffer we own and can start at any
+  // indentation level.
+  std::string buffer;
+  nlohmann::detail::serializer<Json> serializer(nlohmann::detail::output_adapter<char>(buffer), ' ');
+  const bool pretty = indent >= 0;
+  const unsigned int indentStep = pretty ? static_cast<unsigned int>(indent) : 0;
+  const auto dumpValue = [&](const Json& value, unsigned int currentIndent)
+  {
+    serializer.dump(value, pretty, false, indentStep, currentIndent);
+  };
+
+  const auto dumpElements = [&](const Json& array, unsigned int currentIndent)
+  {
+    buffer += '[';
+    for (auto element = array.begin(); element != array.end(); ++element)
+    {
+      if (element != array.begin())
+        buffer += ',';
+      if (pretty)
+      {
+        buffer += '\n';
+        buffer.append(currentIndent + indentStep, ' ');
+      }
+      dumpValue(*element, currentIndent + indentStep);
+
+      sink(buffer);
+      buffer.clear();
+    }
+    if (pretty)
+    {
+      buffer += '\n';
+      buffer.append(currentIndent, ' ');
+    }
+    buffer += ']';
+  };
+
+  if (json.is_array() && !json.empty())
+  {
+    dumpElements(json, 0);
+    sink(buffer);
+    return;
+  }
+
+  const auto docs = json.is_object() ? json.find(key_names::docsKey) : json.end();
+  if (docs == json.end() || !docs->is_array() || docs->empty())
+  {
+    dumpValue(json, 0);
+    sink(buffer);
+    return;
+  }
+
+  buffer += pretty ? "{\n" : "{";
+  for (auto member = json.begin(); member != json.end(); ++member)
+  {
+    if (member != json.begin())
+      buffer += pretty ? ",\n" : ",";
+    buffer.append(indentStep, ' ');
+    dumpValue(Json(member.key()), 0);
+    buffer += pretty ? ": " : ":";
+
+    if (member != docs)
+    {
+      dumpValue(member.value(), indentStep);
+      continue;
+    }
+
+    dumpElements(*docs, indentStep);
+  }
+  buffer += pretty ? "\n}" : "}";
+  sink(buffer);
+}
+
+void serializeBinaryByDoc(const Json& json, wire_format::WireFormat format, const Sink& sink)
+{
+  assert(format != WireFormat::Json);
+
+  std::string buffer;
+  const auto appendElements = [&](const Json& array)
+  {
+    appendContainerHeader(buffer, format, false, array.size());
+    for (const auto& element : array)
+    {
+      appendBinary(buffer, format, element);
+      sink(buffer);
+      buffer.clear();
+    }
+  };
+
+  const auto docs = json.is_object() ? json.find(key_names::docsKey) : json.end();
+  if (json.is_array())
+  {
+    appendElements(json);
+  }
+  else if (docs != json.end() && docs->is_array())
+  {
+    appendContainerHeader(buffer, format, true, json.size());
+    for (auto member = json.begin(); member != json.end(); ++member)
+    {
+      appendBinary(buffer, format, Json(member.key()));
+      if (member == docs)
+        appendElements(*docs);
+      else
+        appendBinary(buffer, format, member.value());
+    }
+  }
+  else
+  {
+    appendBinary(buffer, format, json);
+  }
+  sink(buffer);
+}
+
+}
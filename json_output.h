@@ -0,0 +1,30 @@
+#ifndef JSON_OUTPUT_H
+#define JSON_OUTPUT_H
+
+#include <functional>
+#include <string_view>
+
+#include "nlohmann_json/json.hpp"
+
+#include "wire_format.h"
+
+namespace json_output
+{
+
+using Sink = std::function<void(std::string_view)>;
+
+// Serialises `json` exactly like `std::setw(indent) << json` (or `json.dump()` for a negative
+// indent), but one element of its "docs" array (or of `json` itself, if it's an array) at a time:
+// the text is built in a single reused buffer that is handed to `sink` after every element, so
+// the complete output never exists in memory.
+void serializeByDoc(const nlohmann::json& json, int indent, const Sink& sink);
+
+// The same for CBOR and MessagePack; the output is byte for byte what Json::to_cbor and
+// Json::to_msgpack write. Must not be called with WireFormat::Json.
+void serializeBinaryByDoc(const nlohmann::json& json,
+                          wire_format::WireFormat format,
+                          const Sink& sink);
+
+}
+
+#endif // JSON_OUTPUT_H
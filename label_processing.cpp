@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <exception>
+#include <iostream>
 #include <map>
+#include <optional>
 
 #include "label_processing.h"
 
@@ -35,22 +38,85 @@ std::vector<Json> findNerLabels(const Json& labelsArray)
   return nerLabels;
 }
 
-Json lemmatizeNerLabel(const Json& nerLabel,
-                       const std::string& posTags,
-                       const std::string& lemmaTags,
-                       CascadeLemmatizer& lemmatizer)
+std::string lemmatizeValue(const std::string& value,
+                           const std::string& posTags,
+                           const std::string& lemmaTags,
+                           CascadeLemmatizer& lemmatizer,
+                           LemmaCache* cache)
 {
-  assert(nerLabel.is_object());
-  assert(nerLabel.contains("value"));
-
-  const std::string& inputValue = nerLabel["value"];
+  std::optional<LemmaKey> cacheKey;
+  if (cache)
+  {
+    cacheKey = LemmaKey{value, lemmaTags, posTags};
+    if (auto cachedLemma = cache->find(*cacheKey))
+      return *cachedLemma;
+  }
 
-  auto output = lemmatizer.lemmatize(inputValue.c_str(), lemmaTags.c_str(), posTags.c_str(), false);
+  auto output = lemmatizer.lemmatize(value.c_str(), lemmaTags.c_str(), posTags.c_str(), false);
 
-  Json lemmatizedNer = nerLabel;
   std::string strOutput;
   output.toUTF8String(strOutput);
-  lemmatizedNer["value"] = strOutput;
+
+  if (cache)
+    cache->insert(*cacheKey, strOutput);
+
+  return strOutput;
+}
+
+size_t LemmatizationBatch::add(const std::string& value,
+                               const std::string& posTags,
+                               const std::string& lemmaTags)
+{
+  LemmaKey key{value, lemmaTags, posTags};
+  auto [entry, isNew] = entryIndices_.try_emplace(key, keys_.size());
+  if (isNew)
+  {
+    keys_.push_back(std::move(key));
+    lemmas_.emplace_back();
+  }
+  return entry->second;
+}
+
+bool LemmatizationBatch::lemmatize(CascadeLemmatizer& lemmatizer,
+                                   LemmaCache* cache,
+                                   const StopCondition& shouldStop)
+{
+  for (size_t entry = 0; entry < keys_.size(); ++entry)
+  {
+    if (lemmas_[entry])
+      continue;
+
+    if (shouldStop && shouldStop())
+    {
+      triedEntries_ = entry;
+      return false;
+    }
+
+    const LemmaKey& key = keys_[entry];
+    try
+    {
+      lemmas_[entry] = lemmatizeValue(key.value, key.posTags, key.lemmaTags, lemmatizer, cache);
+    }
+    catch (const std::runtime_error& exception)
+    {
+      std::cout << "Lemmatizing \"" + key.value + "\" failed!\n" + exception.what() + "\n";
+    }
+  }
+  triedEntries_ = keys_.size();
+  return true;
+}
+
+const std::string& LemmatizationBatch::lemma(size_t entry) const
+{
+  if (!lemmas_.at(entry))
+    throw std::runtime_error("No lemma for \"" + keys_[entry].value + "\"");
+  return *lemmas_[entry];
+}
+
+Json makeLemmatizedLabel(const Json& nerLabel, const std::string& lemma)
+{
+  Json lemmatizedNer = nerLabel;
+  lemmatizedNer["value"] = lemma;
   lemmatizedNer[key_names::labelField] = "polem";
   lemmatizedNer["name"] = "polem";
   lemmatizedNer[key_names::labelService] = "Polem";
@@ -58,6 +124,21 @@ Json lemmatizeNerLabel(const Json& nerLabel,
   return lemmatizedNer;
 }
 
+Json lemmatizeNerLabel(const Json& nerLabel,
+                       const std::string& posTags,
+                       const std::string& lemmaTags,
+                       CascadeLemmatizer& lemmatizer,
+                       LemmaCache* cache)
+{
+  assert(nerLabel.is_object());
+  assert(nerLabel.contains("value"));
+
+  const std::string& inputValue = nerLabel["value"];
+
+  return makeLemmatizedLabel(nerLabel,
+                             lemmatizeValue(inputValue, posTags, lemmaTags, lemmatizer, cache));
+}
+
 std::string toLowercase(std::string str)
 {
   std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c){return std::tolower(c);});
@@ -90,26 +171,52 @@ buildPosAndLemmaStringsForNerLabel(const Json& nerLabel,
   return std::make_tuple(posTags, lemmaTags);
 }
 
-std::vector<Json> lemmatizeNerLabels(const std::vector<nlohmann::json>& nerLabels,
-                                     const std::vector<std::string>& posTagValues,
-                                     const std::vector<std::string>& lemmaTagValues,
-                                     CascadeLemmatizer& lemmatizer)
-{ 
+std::vector<size_t> addNerLabelsToBatch(const std::vector<Json>& nerLabels,
+                                        const std::vector<std::string>& posTagValues,
+                                        const std::vector<std::string>& lemmaTagValues,
+                                        LemmatizationBatch& batch)
+{
   if (posTagValues.size() != lemmaTagValues.size())
     throw std::runtime_error("Different counts of posTag and lemma labels!");
 
-  std::vector<Json> lemmatizedLabels;
+  std::vector<size_t> batchEntries;
   for (const auto& nerLabel : nerLabels)
   {
+    assert(nerLabel.is_object());
+    assert(nerLabel.contains("value"));
+
     auto posTagAndLemma = buildPosAndLemmaStringsForNerLabel(nerLabel, posTagValues, lemmaTagValues);
-    lemmatizedLabels.push_back(lemmatizeNerLabel(nerLabel,
-                                                 std::get<0>(posTagAndLemma),
-                                                 std::get<1>(posTagAndLemma),
-                                                 lemmatizer));
+    batchEntries.push_back(batch.add(nerLabel["value"],
+                                     std::get<0>(posTagAndLemma),
+                                     std::get<1>(posTagAndLemma)));
   }
+  return batchEntries;
+}
+
+std::vector<Json> buildLemmatizedLabels(const std::vector<Json>& nerLabels,
+                                        const std::vector<size_t>& batchEntries,
+                                        const LemmatizationBatch& batch)
+{
+  assert(nerLabels.size() == batchEntries.size());
+
+  std::vector<Json> lemmatizedLabels;
+  for (size_t i = 0; i < nerLabels.size(); ++i)
+    lemmatizedLabels.push_back(makeLemmatizedLabel(nerLabels[i], batch.lemma(batchEntries[i])));
   return lemmatizedLabels;
 }
 
+std::vector<Json> lemmatizeNerLabels(const std::vector<nlohmann::json>& nerLabels,
+                                     const std::vector<std::string>& posTagValues,
+                                     const std::vector<std::string>& lemmaTagValues,
+                                     CascadeLemmatizer& lemmatizer,
+                                     LemmaCache* cache)
+{
+  LemmatizationBatch batch;
+  const auto batchEntries = addNerLabelsToBatch(nerLabels, posTagValues, lemmaTagValues, batch);
+  batch.lemmatize(lemmatizer, cache);
+  return buildLemmatizedLabels(nerLabels, batchEntries, batch);
+}
+
 void addLemmatizedLabels(Json& targetLabelsArray, const std::vector<Json>& lemmatizedLabels)
 {
   assert(targetLabelsArray.is_array());
@@ -153,44 +260,150 @@ std::vector<std::string> buildTagValueList(const std::string& tagFieldName,
   return tagValues;
 }
 
-void findAndLemmatizeNerLabelsInJson(nlohmann::json& targetJson)
+namespace
 {
-  if (!targetJson.contains(key_names::docsKey))
-    throw std::runtime_error("Input JSON doesn't contain \"" + key_names::docsKey + "\" key");
 
-  Json& docs = targetJson.at(key_names::docsKey);
-  assert(docs.is_array());
-
-  if (docs.empty())
-    throw std::runtime_error("\"" + key_names::docsKey + "\" item is empty");
+struct PendingDoc
+{
+  size_t docIndex;
+  std::vector<Json> nerLabels;
+  std::vector<size_t> batchEntries;
+};
+
+// Adds the NER labels of `doc` to the batch; docs without labels are skipped, docs that can't be
+// processed are logged and skipped.
+void addDocToBatch(const Json& doc,
+                   size_t docIndex,
+                   LemmatizationBatch& batch,
+                   std::vector<PendingDoc>& pendingDocs)
+{
+  if (!doc.is_object() || !doc.contains(key_names::labelsKey))
+    return;
 
-  CascadeLemmatizer lemmatizer = CascadeLemmatizer::assembleLemmatizer();
+  const Json& labelArray = doc.at(key_names::labelsKey);
+  if (!labelArray.is_array() || labelArray.empty())
+    return;
 
-  for (auto& [key, doc] : docs.items())
+  try
   {
-    if (!doc.is_object() || !doc.contains(key_names::labelsKey))
-      continue;
+    PendingDoc pendingDoc{docIndex, label_processing::findNerLabels(labelArray), {}};
+    const auto& posTagValues = label_processing::buildTagValueList("posTag", labelArray);
+    const auto& lemmaTagValues = label_processing::buildTagValueList("lemmas", labelArray);
+    pendingDoc.batchEntries = label_processing::addNerLabelsToBatch(pendingDoc.nerLabels,
+                                                                    posTagValues,
+                                                                    lemmaTagValues,
+                                                                    batch);
+    pendingDocs.push_back(std::move(pendingDoc));
+  }
+  catch (const std::runtime_error& exception)
+  {
+    std::cout << std::string("Processing a doc element failed!\n") + exception.what() + "\n";
+  }
+}
 
-    Json& labelArray = doc.at(key_names::labelsKey);
-    if (!labelArray.is_array() || labelArray.empty())
+std::vector<DocLemmatization> buildDocLemmatizations(const std::vector<PendingDoc>& pendingDocs,
+                                                     const LemmatizationBatch& batch,
+                                                     std::vector<size_t>* skippedDocIndices = nullptr)
+{
+  std::vector<DocLemmatization> docLemmatizations;
+  for (const auto& pendingDoc : pendingDocs)
+  {
+    const bool isSkipped = std::any_of(pendingDoc.batchEntries.begin(),
+                                       pendingDoc.batchEntries.end(),
+                                       [&batch](size_t entry){ return batch.isSkipped(entry); });
+    if (isSkipped)
+    {
+      if (skippedDocIndices)
+        skippedDocIndices->push_back(pendingDoc.docIndex);
       continue;
+    }
 
     try
     {
-      const auto& nerLabels = label_processing::findNerLabels(labelArray);
-      const auto& posTagValues = label_processing::buildTagValueList("posTag", labelArray);
-      const auto& lemmaTagValues = label_processing::buildTagValueList("lemmas", labelArray);
-      const auto&  lemmatizedLabels = label_processing::lemmatizeNerLabels(nerLabels,
-                                                                           posTagValues,
-                                                                           lemmaTagValues,
-                                                                           lemmatizer);
-      label_processing::addLemmatizedLabels(labelArray, lemmatizedLabels);
+      docLemmatizations.push_back({pendingDoc.docIndex,
+                                   label_processing::buildLemmatizedLabels(pendingDoc.nerLabels,
+                                                                           pendingDoc.batchEntries,
+                                                                           batch)});
     }
     catch (const std::runtime_error& exception)
     {
       std::cout << std::string("Processing a doc element failed!\n") + exception.what() + "\n";
     }
   }
+  return docLemmatizations;
+}
+
+}
+
+std::vector<DocLemmatization> lemmatizeNerLabelsInJson(const nlohmann::json& targetJson,
+                                                       CascadeLemmatizer& lemmatizer,
+                                                       LemmaCache* cache,
+                                                       const StopCondition& shouldStop,
+                                                       std::vector<size_t>* skippedDocIndices)
+{
+  if (!targetJson.contains(key_names::docsKey))
+    throw std::runtime_error("Input JSON doesn't contain \"" + key_names::docsKey + "\" key");
+
+  const Json& docs = targetJson.at(key_names::docsKey);
+  if (!docs.is_array())
+    throw std::runtime_error("\"" + key_names::docsKey + "\" item is not an array");
+
+  if (docs.empty())
+    throw std::runtime_error("\"" + key_names::docsKey + "\" item is empty");
+
+  LemmatizationBatch batch;
+  std::vector<PendingDoc> pendingDocs;
+
+  size_t docIndex = 0;
+  for (; docIndex < docs.size(); ++docIndex)
+  {
+    if (shouldStop && shouldStop())
+      break;
+    addDocToBatch(docs[docIndex], docIndex, batch, pendingDocs);
+  }
+
+  // The batch holds the labels of the docs in order, so a stop leaves the docs that came first
+  // finished.
+  batch.lemmatize(lemmatizer, cache, shouldStop);
+  auto docLemmatizations = buildDocLemmatizations(pendingDocs, batch, skippedDocIndices);
+
+  if (skippedDocIndices)
+  {
+    for (; docIndex < docs.size(); ++docIndex)
+      skippedDocIndices->push_back(docIndex);
+  }
+  return docLemmatizations;
+}
+
+void findAndLemmatizeNerLabelsInJson(nlohmann::json& targetJson,
+                                     CascadeLemmatizer& lemmatizer,
+                                     LemmaCache* cache,
+                                     const StopCondition& shouldStop,
+                                     std::vector<size_t>* skippedDocIndices)
+{
+  const auto docLemmatizations = lemmatizeNerLabelsInJson(targetJson, lemmatizer, cache,
+                                                          shouldStop, skippedDocIndices);
+
+  Json& docs = targetJson.at(key_names::docsKey);
+  for (const auto& docLemmatization : docLemmatizations)
+  {
+    addLemmatizedLabels(docs[docLemmatization.docIndex].at(key_names::labelsKey),
+                        docLemmatization.lemmatizedLabels);
+  }
+}
+
+void findAndLemmatizeNerLabelsInDoc(nlohmann::json& doc,
+                                    CascadeLemmatizer& lemmatizer,
+                                    LemmaCache* cache)
+{
+  LemmatizationBatch batch;
+  std::vector<PendingDoc> pendingDocs;
+
+  addDocToBatch(doc, 0, batch, pendingDocs);
+
+  batch.lemmatize(lemmatizer, cache);
+  for (const auto& docLemmatization : buildDocLemmatizations(pendingDocs, batch))
+    addLemmatizedLabels(doc.at(key_names::labelsKey), docLemmatization.lemmatizedLabels);
 }
 
 }
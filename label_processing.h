@@ -1,12 +1,17 @@
 #ifndef LABEL_PROCESSING_H
 #define LABEL_PROCESSING_H
 
+#include <functional>
+#include <optional>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "nlohmann_json/json.hpp"
 
+#include "lemma_cache.h"
+
 namespace key_names
 {
 const std::string docsKey = "docs";
@@ -20,30 +25,103 @@ class CascadeLemmatizer;
 namespace label_processing
 {
 
+// Asked between docs and between lemmatizations; once it returns true the remaining work is
+// skipped, e.g. because the request's deadline has passed or its client is gone.
+using StopCondition = std::function<bool()>;
+
+// Collects the lemmatization inputs of many NER labels so that every distinct
+// (value, lemmaTags, posTags) combination is passed to Polem only once; the same span is often
+// tagged several times in a doc and the same entities recur across the docs of a request.
+class LemmatizationBatch
+{
+public:
+  size_t add(const std::string& value, const std::string& posTags, const std::string& lemmaTags);
+  // Returns false if it was stopped before lemmatizing every entry.
+  bool lemmatize(CascadeLemmatizer& lemmatizer,
+                 LemmaCache* cache = nullptr,
+                 const StopCondition& shouldStop = {});
+
+  // Throws std::runtime_error if the entry couldn't be lemmatized.
+  const std::string& lemma(size_t entry) const;
+  // Whether lemmatization was stopped before the entry was tried.
+  bool isSkipped(size_t entry) const { return entry >= triedEntries_; }
+  size_t size() const { return keys_.size(); }
+
+private:
+  std::unordered_map<LemmaKey, size_t, LemmaKeyHash> entryIndices_;
+  std::vector<LemmaKey> keys_;
+  std::vector<std::optional<std::string>> lemmas_;
+  size_t triedEntries_ = 0;
+};
+
 std::vector<nlohmann::json> findNerLabels(const nlohmann::json& labelsArray);
 
 std::vector<std::string> buildTagValueList(const std::string& tagFieldName,
                                            const nlohmann::json& labelsArray);
 
+std::string lemmatizeValue(const std::string& value,
+                           const std::string& posTags,
+                           const std::string& lemmaTags,
+                           CascadeLemmatizer& lemmatizer,
+                           LemmaCache* cache = nullptr);
+
+nlohmann::json makeLemmatizedLabel(const nlohmann::json& nerLabel, const std::string& lemma);
+
 nlohmann::json lemmatizeNerLabel(const nlohmann::json& nerLabel,
                                  const std::string& posTags,
                                  const std::string& lemmaTags,
-                                 CascadeLemmatizer& lemmatizer);
+                                 CascadeLemmatizer& lemmatizer,
+                                 LemmaCache* cache = nullptr);
 
 std::tuple<std::string, std::string>
 buildPosAndLemmaStringsForNerLabel(const nlohmann::json& nerLabel,
                                    const std::vector<std::string>& posTagValues,
                                    const std::vector<std::string>& lemmaTagValues);
 
+std::vector<size_t> addNerLabelsToBatch(const std::vector<nlohmann::json>& nerLabels,
+                                        const std::vector<std::string>& posTagValues,
+                                        const std::vector<std::string>& lemmaTagValues,
+                                        LemmatizationBatch& batch);
+
+std::vector<nlohmann::json> buildLemmatizedLabels(const std::vector<nlohmann::json>& nerLabels,
+                                                  const std::vector<size_t>& batchEntries,
+                                                  const LemmatizationBatch& batch);
+
 std::vector<nlohmann::json> lemmatizeNerLabels(const std::vector<nlohmann::json>& nerLabels,
                                                const std::vector<std::string>& posTagValues,
                                                const std::vector<std::string>& lemmaTagValues,
-                                               CascadeLemmatizer& lemmatizer);
+                                               CascadeLemmatizer& lemmatizer,
+                                               LemmaCache* cache = nullptr);
 
 void addLemmatizedLabels(nlohmann::json& targetLabelsArray,
                          const std::vector<nlohmann::json>& lemmatizedLabels);
 
-void findAndLemmatizeNerLabelsInJson(nlohmann::json& targetJson);
+// The Polem labels lemmatized for one element of "docs".
+struct DocLemmatization
+{
+  size_t docIndex;
+  std::vector<nlohmann::json> lemmatizedLabels;
+};
+
+// Lemmatizes the NER labels of every doc without modifying the JSON; docs without labels and docs
+// that fail to process have no entry in the result. If `shouldStop` ends the work early, the
+// indices of the docs left unfinished go to `skippedDocIndices`, in order.
+std::vector<DocLemmatization> lemmatizeNerLabelsInJson(const nlohmann::json& targetJson,
+                                                       CascadeLemmatizer& lemmatizer,
+                                                       LemmaCache* cache = nullptr,
+                                                       const StopCondition& shouldStop = {},
+                                                       std::vector<size_t>* skippedDocIndices = nullptr);
+
+void findAndLemmatizeNerLabelsInJson(nlohmann::json& targetJson,
+                                     CascadeLemmatizer& lemmatizer,
+                                     LemmaCache* cache = nullptr,
+                                     const StopCondition& shouldStop = {},
+                                     std::vector<size_t>* skippedDocIndices = nullptr);
+
+// Lemmatizes a single element of "docs", e.g. one line of an NDJSON stream.
+void findAndLemmatizeNerLabelsInDoc(nlohmann::json& doc,
+                                    CascadeLemmatizer& lemmatizer,
+                                    LemmaCache* cache = nullptr);
 
 }
 
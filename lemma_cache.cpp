@@ -0,0 +1,247 @@
+#include "lemma_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+
+// Rough per-entry bookkeeping cost: list node, hash map node and the std::string headers.
+constexpr size_t entryOverheadBytes = 160;
+
+// Rough average entry size, used only to size the frequency sketch.
+constexpr size_t expectedEntryBytes = 256;
+
+size_t combineHashes(size_t seed, size_t hash)
+{
+  return seed ^ (hash + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+constexpr size_t sketchRowSeeds[] = {
+  0x9e3779b97f4a7c15ull, 0xbf58476d1ce4e5b9ull, 0x94d049bb133111ebull, 0xd6e8feb86659fd93ull
+};
+
+size_t mixHash(size_t hash)
+{
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+}
+
+size_t LemmaKeyHash::operator()(const LemmaKey& key) const
+{
+  const std::hash<std::string> stringHash;
+  size_t hash = stringHash(key.value);
+  hash = combineHashes(hash, stringHash(key.lemmaTags));
+  hash = combineHashes(hash, stringHash(key.posTags));
+  return hash;
+}
+
+FrequencySketch::FrequencySketch(size_t expectedEntries)
+{
+  size_t width = 64;
+  while (width < expectedEntries)
+    width *= 2;
+
+  counters_.assign(width * depth, 0);
+  sampleSize_ = width * 10;
+}
+
+void FrequencySketch::recordAccess(size_t keyHash)
+{
+  for (size_t row = 0; row < depth; ++row)
+  {
+    auto& counter = counters_[counterIndex(keyHash, row)];
+    if (counter < maxCount)
+      ++counter;
+  }
+
+  if (++recordedAccesses_ >= sampleSize_)
+    age();
+}
+
+uint8_t FrequencySketch::estimateFrequency(size_t keyHash) const
+{
+  uint8_t frequency = maxCount;
+  for (size_t row = 0; row < depth; ++row)
+    frequency = std::min(frequency, counters_[counterIndex(keyHash, row)]);
+  return frequency;
+}
+
+size_t FrequencySketch::counterIndex(size_t keyHash, size_t row) const
+{
+  static_assert(std::size(sketchRowSeeds) == depth);
+  const size_t width = counters_.size() / depth;
+  // Seeded per row, so that no row reuses the hash that picks the shard: every key of a shard
+  // shares its low bits, and a row indexed by them would use a fraction of its counters.
+  const size_t rowHash = mixHash(keyHash ^ sketchRowSeeds[row]);
+  return row * width + (rowHash & (width - 1));
+}
+
+void FrequencySketch::age()
+{
+  for (auto& counter : counters_)
+    counter /= 2;
+  recordedAccesses_ /= 2;
+}
+
+LemmaCache::Shard::Shard(size_t byteBudget)
+  : frequencySketch(std::max<size_t>(byteBudget / expectedEntryBytes, 1)), byteBudget(byteBudget)
+{
+  statistics.byteBudget = byteBudget;
+}
+
+LemmaCache::LemmaCache(size_t byteBudget, size_t shardCount)
+  : byteBudget_(byteBudget)
+{
+  if (shardCount == 0)
+    throw std::invalid_argument("Lemma cache needs at least one shard");
+
+  for (size_t i = 0; i < shardCount; ++i)
+    shards_.push_back(std::make_unique<Shard>(byteBudget / shardCount));
+}
+
+std::optional<std::string> LemmaCache::find(const LemmaKey& key)
+{
+  const size_t keyHash = LemmaKeyHash()(key);
+  Shard& shard = shardFor(keyHash);
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.frequencySketch.recordAccess(keyHash);
+
+  auto found = shard.index.find(key);
+  if (found == shard.index.end())
+  {
+    ++shard.statistics.misses;
+    return std::nullopt;
+  }
+
+  ++shard.statistics.hits;
+  shard.recencyList.splice(shard.recencyList.begin(), shard.recencyList, found->second);
+  return found->second->lemma;
+}
+
+void LemmaCache::insert(const LemmaKey& key, const std::string& lemma)
+{
+  const size_t keyHash = LemmaKeyHash()(key);
+  const size_t size = entrySize(key, lemma);
+  Shard& shard = shardFor(keyHash);
+
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (size > shard.byteBudget || shard.index.count(key) != 0)
+      return;
+
+    const uint8_t candidateFrequency = shard.frequencySketch.estimateFrequency(keyHash);
+    while (shard.bytes + size > shard.byteBudget)
+    {
+      const Entry& victim = shard.recencyList.back();
+      const uint8_t victimFrequency
+          = shard.frequencySketch.estimateFrequency(LemmaKeyHash()(victim.key));
+      if (candidateFrequency <= victimFrequency)
+      {
+        ++shard.statistics.rejections;
+        return;
+      }
+
+      shard.bytes -= victim.size;
+      shard.index.erase(victim.key);
+      shard.recencyList.pop_back();
+      ++shard.statistics.evictions;
+    }
+
+    shard.recencyList.push_front(Entry{key, lemma, size});
+    shard.index.emplace(key, shard.recencyList.begin());
+    shard.bytes += size;
+    ++shard.statistics.insertions;
+  }
+
+  if (insertionObserver_)
+    insertionObserver_(key, lemma);
+}
+
+bool LemmaCache::preload(const LemmaKey& key, const std::string& lemma)
+{
+  const size_t keyHash = LemmaKeyHash()(key);
+  const size_t size = entrySize(key, lemma);
+  Shard& shard = shardFor(keyHash);
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (shard.index.count(key) != 0)
+    return true;
+  if (shard.bytes + size > shard.byteBudget)
+    return false;
+
+  shard.recencyList.push_front(Entry{key, lemma, size});
+  shard.index.emplace(key, shard.recencyList.begin());
+  shard.bytes += size;
+  return true;
+}
+
+void LemmaCache::clear()
+{
+  for (auto& shard : shards_)
+  {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->index.clear();
+    shard->recencyList.clear();
+    shard->bytes = 0;
+  }
+}
+
+void LemmaCache::forEachEntry(const EntryVisitor& visitor,
+                              const std::function<void()>& afterShard) const
+{
+  for (const auto& shard : shards_)
+  {
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      for (const auto& entry : shard->recencyList)
+        visitor(entry.key, entry.lemma);
+    }
+    if (afterShard)
+      afterShard();
+  }
+}
+
+void LemmaCache::setInsertionObserver(InsertionObserver observer)
+{
+  insertionObserver_ = std::move(observer);
+}
+
+LemmaCache::Statistics LemmaCache::statistics() const
+{
+  Statistics total;
+  total.byteBudget = byteBudget_;
+  for (const auto& shard : shards_)
+  {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    total.hits += shard->statistics.hits;
+    total.misses += shard->statistics.misses;
+    total.insertions += shard->statistics.insertions;
+    total.evictions += shard->statistics.evictions;
+    total.rejections += shard->statistics.rejections;
+    total.entries += shard->index.size();
+    total.bytes += shard->bytes;
+  }
+  return total;
+}
+
+size_t LemmaCache::entrySize(const LemmaKey& key, const std::string& lemma)
+{
+  // Keys are stored twice: in the recency list entry and in the index.
+  const size_t keyBytes = key.value.size() + key.lemmaTags.size() + key.posTags.size();
+  return 2 * keyBytes + lemma.size() + entryOverheadBytes;
+}
+
+LemmaCache::Shard& LemmaCache::shardFor(size_t keyHash)
+{
+  return *shards_[mixHash(keyHash) % shards_.size()];
+}
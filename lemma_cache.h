@@ -0,0 +1,124 @@
+#ifndef LEMMA_CACHE_H
+#define LEMMA_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct LemmaKey
+{
+  std::string value;
+  std::string lemmaTags;
+  std::string posTags;
+
+  bool operator==(const LemmaKey& other) const
+  {
+    return value == other.value && lemmaTags == other.lemmaTags && posTags == other.posTags;
+  }
+};
+
+struct LemmaKeyHash
+{
+  size_t operator()(const LemmaKey& key) const;
+};
+
+// Approximate access counts of recently seen keys (a count-min sketch with periodic aging),
+// used to keep keys seen once from evicting frequently requested ones.
+class FrequencySketch
+{
+public:
+  explicit FrequencySketch(size_t expectedEntries);
+
+  void recordAccess(size_t keyHash);
+  uint8_t estimateFrequency(size_t keyHash) const;
+
+private:
+  static constexpr size_t depth = 4;
+  static constexpr uint8_t maxCount = 15;
+
+  size_t counterIndex(size_t keyHash, size_t row) const;
+  void age();
+
+  std::vector<uint8_t> counters_;
+  size_t sampleSize_;
+  size_t recordedAccesses_ = 0;
+};
+
+// Thread-safe, byte-bounded LRU cache of Polem results. Keys are spread over independently
+// locked shards, and a full shard only admits a new entry if it has been requested more
+// often than the entry it would evict.
+class LemmaCache
+{
+public:
+  struct Statistics
+  {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;
+    uint64_t rejections = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t byteBudget = 0;
+  };
+
+  using InsertionObserver = std::function<void(const LemmaKey& key, const std::string& lemma)>;
+  using EntryVisitor = std::function<void(const LemmaKey& key, const std::string& lemma)>;
+
+  explicit LemmaCache(size_t byteBudget, size_t shardCount = 16);
+  LemmaCache(const LemmaCache&) = delete;
+  LemmaCache& operator=(const LemmaCache&) = delete;
+
+  std::optional<std::string> find(const LemmaKey& key);
+  void insert(const LemmaKey& key, const std::string& lemma);
+  // Inserts without the admission check and without notifying the observer, for entries
+  // restored from disk. Returns false once the target shard is full.
+  bool preload(const LemmaKey& key, const std::string& lemma);
+  void clear();
+  // Visits every entry, a shard at a time and most recently used first, with the shard locked;
+  // `afterShard` runs between shards without a lock, for the slow part of the work.
+  void forEachEntry(const EntryVisitor& visitor,
+                    const std::function<void()>& afterShard = {}) const;
+
+  // Called after every admitted insert; must be set before the cache is shared between threads.
+  void setInsertionObserver(InsertionObserver observer);
+
+  Statistics statistics() const;
+
+  static size_t entrySize(const LemmaKey& key, const std::string& lemma);
+
+private:
+  struct Entry
+  {
+    LemmaKey key;
+    std::string lemma;
+    size_t size;
+  };
+
+  struct Shard
+  {
+    explicit Shard(size_t byteBudget);
+
+    std::mutex mutex;
+    std::list<Entry> recencyList;
+    std::unordered_map<LemmaKey, std::list<Entry>::iterator, LemmaKeyHash> index;
+    FrequencySketch frequencySketch;
+    size_t byteBudget;
+    size_t bytes = 0;
+    Statistics statistics;
+  };
+
+  Shard& shardFor(size_t keyHash);
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  size_t byteBudget_;
+  InsertionObserver insertionObserver_;
+};
+
+#endif // LEMMA_CACHE_H
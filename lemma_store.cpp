@@ -0,0 +1,471 @@
+#include "lemma_store.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr char fileMagic[4] = {'P', 'L', 'M', 'S'};
+constexpr uint32_t fileFormatVersion = 1;
+constexpr size_t fileHeaderSize = sizeof(fileMagic) + sizeof(uint32_t) + sizeof(uint64_t);
+constexpr size_t recordHeaderSize = 2 * sizeof(uint32_t);
+constexpr size_t recordFieldCount = 4;
+constexpr auto writerFlushInterval = std::chrono::seconds(1);
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+uint32_t checksum(const char* data, size_t size)
+{
+  const uint64_t hash = fnv1a(data, size);
+  return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+template <typename T>
+void appendPod(std::string& buffer, T value)
+{
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T readPod(const char* data)
+{
+  T value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+std::string encodeHeader(uint64_t dictionaryFingerprint)
+{
+  std::string header(fileMagic, sizeof(fileMagic));
+  appendPod(header, fileFormatVersion);
+  appendPod(header, dictionaryFingerprint);
+  return header;
+}
+
+void encodeRecord(std::string& buffer, const LemmaKey& key, const std::string& lemma)
+{
+  const std::string* fields[recordFieldCount] = {&key.value, &key.lemmaTags, &key.posTags, &lemma};
+
+  std::string payload;
+  for (const auto* field : fields)
+  {
+    appendPod(payload, static_cast<uint32_t>(field->size()));
+    payload += *field;
+  }
+
+  appendPod(buffer, static_cast<uint32_t>(payload.size()));
+  appendPod(buffer, checksum(payload.data(), payload.size()));
+  buffer += payload;
+}
+
+bool decodeRecord(const char* payload, size_t payloadSize, LemmaKey& key, std::string& lemma)
+{
+  std::string* fields[recordFieldCount] = {&key.value, &key.lemmaTags, &key.posTags, &lemma};
+
+  size_t offset = 0;
+  for (auto* field : fields)
+  {
+    if (payloadSize - offset < sizeof(uint32_t))
+      return false;
+    const auto fieldSize = readPod<uint32_t>(payload + offset);
+    offset += sizeof(uint32_t);
+
+    if (payloadSize - offset < fieldSize)
+      return false;
+    field->assign(payload + offset, fieldSize);
+    offset += fieldSize;
+  }
+
+  return offset == payloadSize;
+}
+
+// Walks the records of a mapped file and returns the length of its valid prefix.
+template <typename RecordCallback>
+size_t scanRecords(const char* data, size_t size, RecordCallback onRecord)
+{
+  size_t offset = fileHeaderSize;
+  LemmaKey key;
+  std::string lemma;
+
+  while (size - offset >= recordHeaderSize)
+  {
+    const auto payloadSize = readPod<uint32_t>(data + offset);
+    const auto payloadChecksum = readPod<uint32_t>(data + offset + sizeof(uint32_t));
+    const char* payload = data + offset + recordHeaderSize;
+
+    if (size - offset - recordHeaderSize < payloadSize
+        || checksum(payload, payloadSize) != payloadChecksum
+        || !decodeRecord(payload, payloadSize, key, lemma))
+      break;
+
+    onRecord(key, lemma);
+    offset += recordHeaderSize + payloadSize;
+  }
+
+  return offset;
+}
+
+class MappedFile
+{
+public:
+  explicit MappedFile(const fs::path& path)
+  {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      throw std::runtime_error("Failed to open file " + path.string());
+
+    struct stat fileStatus;
+    if (::fstat(fd, &fileStatus) == 0 && fileStatus.st_size > 0)
+    {
+      size_ = static_cast<size_t>(fileStatus.st_size);
+      void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED)
+      {
+        data_ = static_cast<const char*>(mapping);
+        ::madvise(mapping, size_, MADV_SEQUENTIAL);
+      }
+    }
+    ::close(fd);
+
+    if (size_ > 0 && !data_)
+      throw std::runtime_error("Failed to map file " + path.string());
+  }
+
+  ~MappedFile()
+  {
+    if (data_)
+      ::munmap(const_cast<char*>(data_), size_);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+bool writeAll(int fd, const char* data, size_t size)
+{
+  while (size > 0)
+  {
+    const ssize_t written = ::write(fd, data, size);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+}
+
+LemmaStore::LemmaStore(fs::path path,
+                       uint64_t dictionaryFingerprint,
+                       uintmax_t maxFileBytes,
+                       std::shared_ptr<const LemmaCache> liveEntries)
+  : path_(std::move(path)),
+    dictionaryFingerprint_(dictionaryFingerprint),
+    maxFileBytes_(maxFileBytes),
+    liveEntries_(std::move(liveEntries))
+{
+  openFile();
+  writer_ = std::thread(&LemmaStore::runWriter, this);
+}
+
+LemmaStore::~LemmaStore()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  recordsPending_.notify_one();
+  writer_.join();
+
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+size_t LemmaStore::loadInto(LemmaCache& cache) const
+{
+  MappedFile file(path_);
+  if (file.size() <= fileHeaderSize)
+    return 0;
+
+  // Counted by the cache, since the file may hold duplicates and more than the cache takes.
+  const size_t previousEntries = cache.statistics().entries;
+  scanRecords(file.data(), file.size(), [&](const LemmaKey& key, const std::string& lemma)
+  {
+    cache.preload(key, lemma);
+  });
+
+  return cache.statistics().entries - previousEntries;
+}
+
+void LemmaStore::append(const LemmaKey& key, const std::string& lemma)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fileBytes_ + pendingRecords_.size() < maxFileBytes_)
+  {
+    encodeRecord(pendingRecords_, key, lemma);
+    return;
+  }
+
+  // The entry is in the cache already, so the compacted file will have it.
+  if (liveEntries_)
+  {
+    if (!compactionPending_)
+    {
+      compactionPending_ = true;
+      recordsPending_.notify_one();
+    }
+    return;
+  }
+
+  if (!reportedFull_)
+  {
+    std::cout << "> Lemma store " << path_ << " is full, new lemmas are not persisted\n";
+    reportedFull_ = true;
+  }
+}
+
+void LemmaStore::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  flushRequested_ = true;
+  recordsPending_.notify_one();
+  recordsWritten_.wait(lock, [this]
+  {
+    return pendingRecords_.empty() && !compactionPending_ && !writing_;
+  });
+}
+
+uint64_t LemmaStore::dictionaryFingerprint(const std::vector<fs::path>& dictionaryPaths,
+                                           const std::string& dictionaryVersion)
+{
+  uint64_t fingerprint = fnv1a(dictionaryVersion.data(), dictionaryVersion.size());
+
+  auto addFile = [&fingerprint](const fs::path& file)
+  {
+    const std::string name = file.string();
+    const auto size = static_cast<uint64_t>(fs::file_size(file));
+    const auto modificationTime = fs::last_write_time(file).time_since_epoch().count();
+    fingerprint = fnv1a(name.data(), name.size(), fingerprint);
+    fingerprint = fnv1a(&size, sizeof(size), fingerprint);
+    fingerprint = fnv1a(&modificationTime, sizeof(modificationTime), fingerprint);
+  };
+
+  for (const auto& path : dictionaryPaths)
+  {
+    if (!fs::is_directory(path))
+    {
+      addFile(path);
+      continue;
+    }
+
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::recursive_directory_iterator(path))
+      if (entry.is_regular_file())
+        files.push_back(entry.path());
+
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files)
+      addFile(file);
+  }
+
+  return fingerprint;
+}
+
+void LemmaStore::openFile()
+{
+  const std::string expectedHeader = encodeHeader(dictionaryFingerprint_);
+
+  // Keep the valid prefix of an existing file written with the same dictionaries; anything
+  // else (other dictionaries, other format, corrupted header) starts from scratch.
+  uintmax_t validBytes = 0;
+  if (fs::exists(path_))
+  {
+    MappedFile file(path_);
+    if (file.size() >= fileHeaderSize
+        && std::memcmp(file.data(), expectedHeader.data(), fileHeaderSize) == 0)
+      validBytes = scanRecords(file.data(), file.size(), [](const LemmaKey&, const std::string&){});
+  }
+
+  fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0)
+    throw std::runtime_error("Failed to open lemma store " + path_.string());
+
+  if (validBytes == 0)
+  {
+    if (::ftruncate(fd_, 0) != 0 || !writeAll(fd_, expectedHeader.data(), expectedHeader.size()))
+      throw std::runtime_error("Failed to initialise lemma store " + path_.string());
+    validBytes = expectedHeader.size();
+  }
+  else if (::ftruncate(fd_, static_cast<off_t>(validBytes)) != 0)
+  {
+    throw std::runtime_error("Failed to truncate lemma store " + path_.string());
+  }
+
+  if (::lseek(fd_, static_cast<off_t>(validBytes), SEEK_SET) < 0)
+    throw std::runtime_error("Failed to seek in lemma store " + path_.string());
+  ::fdatasync(fd_);
+
+  fileBytes_ = validBytes;
+}
+
+void LemmaStore::writePendingRecords()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (pendingRecords_.empty())
+    return;
+
+  std::string records;
+  records.swap(pendingRecords_);
+  writing_ = true;
+  lock.unlock();
+
+  const bool written = writeAll(fd_, records.data(), records.size()) && ::fdatasync(fd_) == 0;
+
+  lock.lock();
+  writing_ = false;
+  if (written)
+  {
+    fileBytes_ += records.size();
+  }
+  else
+  {
+    // Drop the batch and cut off whatever part of it reached the file, so later records
+    // don't end up behind a torn one.
+    std::cout << "> Failed to write to lemma store " << path_ << "\n";
+    if (::ftruncate(fd_, static_cast<off_t>(fileBytes_)) != 0
+        || ::lseek(fd_, static_cast<off_t>(fileBytes_), SEEK_SET) < 0)
+      fileBytes_ = maxFileBytes_;
+  }
+  recordsWritten_.notify_all();
+}
+
+void LemmaStore::compact()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!compactionPending_)
+    return;
+
+  // Whatever is pending is in the cache as well.
+  pendingRecords_.clear();
+  writing_ = true;
+  lock.unlock();
+
+  const fs::path compactedPath = path_.string() + ".compacting";
+  uintmax_t compactedBytes = 0;
+  bool compacted = false;
+  const int compactedFd = ::open(compactedPath.c_str(),
+                                 O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (compactedFd >= 0)
+  {
+    try
+    {
+      writeCompactedFile(compactedFd, compactedBytes);
+      compacted = ::fdatasync(compactedFd) == 0
+          && ::rename(compactedPath.c_str(), path_.c_str()) == 0;
+    }
+    catch (const std::exception&)
+    {
+    }
+  }
+
+  lock.lock();
+  if (compacted)
+  {
+    ::close(fd_);
+    fd_ = compactedFd;
+    fileBytes_ = compactedBytes;
+    std::cout << "> Lemma store " << path_ << " compacted to " << compactedBytes << " bytes\n";
+  }
+  else
+  {
+    if (compactedFd >= 0)
+      ::close(compactedFd);
+    ::unlink(compactedPath.c_str());
+    // The old file stays as it is, and full.
+    std::cout << "> Failed to compact lemma store " << path_ << "\n";
+  }
+  compactionPending_ = false;
+  writing_ = false;
+  recordsWritten_.notify_all();
+}
+
+void LemmaStore::writeCompactedFile(int fd, uintmax_t& fileBytes) const
+{
+  // Half the limit at most, so that it takes a while of new lemmas before the next compaction.
+  const uintmax_t maxCompactedBytes = maxFileBytes_ / 2;
+  std::string records = encodeHeader(dictionaryFingerprint_);
+  bool failed = false;
+
+  liveEntries_->forEachEntry([&](const LemmaKey& key, const std::string& lemma)
+  {
+    const size_t previousSize = records.size();
+    encodeRecord(records, key, lemma);
+    if (fileBytes + records.size() > maxCompactedBytes)
+      records.resize(previousSize);
+  },
+  [&]
+  {
+    failed = failed || !writeAll(fd, records.data(), records.size());
+    fileBytes += records.size();
+    records.clear();
+  });
+
+  if (failed || !writeAll(fd, records.data(), records.size()))
+    throw std::runtime_error("Failed to write the compacted lemma store");
+  fileBytes += records.size();
+}
+
+void LemmaStore::runWriter()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_)
+  {
+    // A flush or compaction requested while the writer was busy mustn't wait for the next round.
+    recordsPending_.wait_for(lock, writerFlushInterval, [this]
+    {
+      return stopping_ || flushRequested_ || compactionPending_;
+    });
+    flushRequested_ = false;
+    lock.unlock();
+    compact();
+    writePendingRecords();
+    lock.lock();
+  }
+
+  lock.unlock();
+  compact();
+  writePendingRecords();
+}
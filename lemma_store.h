@@ -0,0 +1,68 @@
+#ifndef LEMMA_STORE_H
+#define LEMMA_STORE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lemma_cache.h"
+
+// Append-only file of lemmatization results that outlives the process. Every record carries
+// its own length and checksum, so a record torn by a crash is detected and cut off on the next
+// start. The file header holds a fingerprint of Polem's dictionaries; a file written with other
+// dictionaries is discarded instead of loaded. When the file reaches its size limit it is
+// rewritten from the live cache, which also drops the duplicates and the evicted entries.
+class LemmaStore
+{
+public:
+  // Without `liveEntries`, nothing more is stored once the file is full.
+  LemmaStore(std::filesystem::path path,
+             uint64_t dictionaryFingerprint,
+             uintmax_t maxFileBytes,
+             std::shared_ptr<const LemmaCache> liveEntries = nullptr);
+  ~LemmaStore();
+  LemmaStore(const LemmaStore&) = delete;
+  LemmaStore& operator=(const LemmaStore&) = delete;
+
+  // Preloads stored entries into the cache; returns the number of entries it took.
+  size_t loadInto(LemmaCache& cache) const;
+
+  // Queues an entry for the background writer; never blocks on disk I/O.
+  void append(const LemmaKey& key, const std::string& lemma);
+  void flush();
+
+  static uint64_t dictionaryFingerprint(const std::vector<std::filesystem::path>& dictionaryPaths,
+                                        const std::string& dictionaryVersion);
+
+private:
+  void openFile();
+  void writePendingRecords();
+  void compact();
+  void writeCompactedFile(int fd, uintmax_t& fileBytes) const;
+  void runWriter();
+
+  const std::filesystem::path path_;
+  const uint64_t dictionaryFingerprint_;
+  const uintmax_t maxFileBytes_;
+  const std::shared_ptr<const LemmaCache> liveEntries_;
+  int fd_ = -1;
+  uintmax_t fileBytes_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable recordsPending_;
+  std::condition_variable recordsWritten_;
+  std::string pendingRecords_;
+  bool writing_ = false;
+  bool compactionPending_ = false;
+  bool flushRequested_ = false;
+  bool reportedFull_ = false;
+  bool stopping_ = false;
+  std::thread writer_;
+};
+
+#endif // LEMMA_STORE_H
@@ -0,0 +1,250 @@
+#include "lemmatizer_loader.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "cache_warmup.h"
+#include "dictionary_prefetch.h"
+#include "lemma_cache.h"
+#include "lemma_store.h"
+#include "lemmatizer_pool.h"
+#include "service_state.h"
+
+namespace
+{
+
+// Shares `object` for publishing. Its last user, whichever thread that is, hands it over to
+// `released` instead of destroying it.
+template <typename T>
+std::shared_ptr<T> shareForPublishing(std::unique_ptr<T> object,
+                                      std::future<std::unique_ptr<T>>& released)
+{
+  auto release = std::make_shared<std::promise<std::unique_ptr<T>>>();
+  released = release->get_future();
+  return std::shared_ptr<T>(object.release(), [release](T* unusedObject)
+  {
+    release->set_value(std::unique_ptr<T>(unusedObject));
+  });
+}
+
+// Waits until every user has dropped its reference to an unpublished object and destroys it
+// here, so e.g. a retired pool's dictionaries aren't freed on a request thread.
+template <typename T>
+void destroyWhenReleased(std::future<std::unique_ptr<T>>& released)
+{
+  if (released.valid())
+    released.get();
+}
+
+}
+
+LemmatizerLoader::LemmatizerLoader(ServerConfig config, std::shared_ptr<ServiceState> state)
+  : config_(std::move(config)), state_(std::move(state))
+{
+}
+
+LemmatizerLoader::~LemmatizerLoader() = default;
+
+void LemmatizerLoader::run()
+{
+  load();
+
+  while (true)
+  {
+    state_->waitForReloadRequest();
+    reload();
+    state_->finishReload();
+  }
+}
+
+void LemmatizerLoader::load()
+{
+  try
+  {
+    prefetchDictionaries();
+    dictionaryFingerprint_ = dictionaryFingerprint();
+    // A single process starts with one lemmatizer and grows the pool as requests come in.
+    auto lemmatizerPool = assembleLemmatizerPool(isPrefork() ? config_.lemmatizerCount : 1,
+                                                 poolReleased_);
+
+    if (auto lemmaCache = state_->lemmaCache(); lemmaCache && !config_.lemmaStorePath.empty())
+    {
+      if (!dictionaryFingerprint_)
+      {
+        std::cout << "> The lemma store can't tell when the dictionaries change; identify them "
+                     "with --dictionary-version\n";
+      }
+
+      openLemmaStore(lemmaCache);
+      if (auto lemmaStore = state_->lemmaStore())
+      {
+        const auto loadedEntries = lemmaStore->loadInto(*lemmaCache);
+        std::cout << "> Restored " << loadedEntries << " lemma(s) from "
+                  << config_.lemmaStorePath << "\n";
+      }
+
+      // The workers start with the restored lemmas but don't persist the ones they add.
+      if (isPrefork())
+        closeLemmaStore();
+    }
+
+    if (!config_.warmupCorpusPaths.empty())
+    {
+      state_->setStatus(ServiceState::Status::WarmingUp);
+      warmUp(*lemmatizerPool, state_->lemmaCache().get());
+    }
+
+    state_->setLemmatizerPool(std::move(lemmatizerPool));
+    state_->setStatus(ServiceState::Status::Ready);
+    std::cout << "> Ready to serve!\n";
+  }
+  catch (const std::exception& exception)
+  {
+    state_->setStatus(ServiceState::Status::Failed);
+    std::cout << "> Failed to load the lemmatizer: " << exception.what() << "\n";
+  }
+}
+
+void LemmatizerLoader::reload()
+{
+  std::cout << "> Reloading the lemmatizer...\n";
+  try
+  {
+    prefetchDictionaries();
+    const auto fingerprint = dictionaryFingerprint();
+    // The traffic is already there, so the whole pool is assembled and warmed before the swap
+    // rather than on the request path.
+    std::future<std::unique_ptr<LemmatizerPool>> poolReleased;
+    auto lemmatizerPool = assembleLemmatizerPool(config_.lemmatizerCount, poolReleased);
+
+    // Cached lemmas of other dictionaries would be served by the new pool, so the cache is
+    // replaced in the same step as the pool; requests on the old pool keep the old cache.
+    const bool dictionariesChanged = !fingerprint || fingerprint != dictionaryFingerprint_;
+    auto lemmaCache = state_->lemmaCache();
+    std::shared_ptr<LemmaCache> replacementCache;
+    if (lemmaCache && dictionariesChanged)
+    {
+      std::cout << (fingerprint ? "> Dictionaries changed" : "> Dictionaries unidentified")
+                << ", starting with an empty lemma cache\n";
+      replacementCache = std::make_shared<LemmaCache>(config_.lemmaCacheBytes);
+      lemmaCache = replacementCache;
+    }
+
+    if (!config_.warmupCorpusPaths.empty())
+      warmUp(*lemmatizerPool, lemmaCache.get());
+
+    dictionaryFingerprint_ = fingerprint;
+    if (replacementCache)
+    {
+      if (!config_.lemmaStorePath.empty())
+      {
+        openLemmaStore(replacementCache);
+        if (isPrefork())
+          closeLemmaStore();
+      }
+      state_->setLemmatizerPool(std::move(lemmatizerPool), std::move(replacementCache));
+    }
+    else
+    {
+      state_->setLemmatizerPool(std::move(lemmatizerPool));
+    }
+    state_->setStatus(ServiceState::Status::Ready);
+    std::cout << "> Reloaded lemmatizer is serving\n";
+
+    std::swap(poolReleased_, poolReleased);
+    destroyWhenReleased(poolReleased);
+  }
+  catch (const std::exception& exception)
+  {
+    std::cout << "> Reload failed, keeping the current lemmatizer: " << exception.what() << "\n";
+  }
+}
+
+void LemmatizerLoader::prefetchDictionaries() const
+{
+  for (const auto& prefetchPath : config_.dictionaryPrefetchPaths)
+  {
+    try
+    {
+      const auto prefetchedBytes = dictionary_prefetch::prefetchIntoPageCache(prefetchPath);
+      std::cout << "> Prefetching " << prefetchedBytes << " bytes from " << prefetchPath << "\n";
+    }
+    catch (const std::exception& exception)
+    {
+      std::cout << "> Dictionary prefetch failed: " << exception.what() << "\n";
+    }
+  }
+}
+
+std::shared_ptr<LemmatizerPool> LemmatizerLoader::assembleLemmatizerPool(
+    size_t preassembledLemmatizerCount,
+    std::future<std::unique_ptr<LemmatizerPool>>& released) const
+{
+  std::cout << "> Assembling the lemmatizer...\n";
+  const auto assemblyStart = std::chrono::steady_clock::now();
+  auto lemmatizerPool = std::make_unique<LemmatizerPool>(config_.lemmatizerCount,
+                                                         preassembledLemmatizerCount);
+  const auto assemblyTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - assemblyStart);
+  std::cout << "> Lemmatizer assembled in " << assemblyTime.count() << " ms\n";
+
+  return shareForPublishing(std::move(lemmatizerPool), released);
+}
+
+void LemmatizerLoader::openLemmaStore(const std::shared_ptr<LemmaCache>& lemmaCache)
+{
+  // The previous store has to be closed before its file is reopened with a new fingerprint.
+  closeLemmaStore();
+
+  try
+  {
+    auto lemmaStore = shareForPublishing(
+          std::make_unique<LemmaStore>(config_.lemmaStorePath,
+                                       dictionaryFingerprint_.value_or(0),
+                                       config_.lemmaStoreMaxBytes,
+                                       lemmaCache),
+          storeReleased_);
+    // Bound to this store rather than to whichever the state holds, so that lemmas still added
+    // to a replaced cache don't end up in the store of its successor.
+    lemmaCache->setInsertionObserver(
+          [weakStore = std::weak_ptr<LemmaStore>(lemmaStore)](const LemmaKey& key,
+                                                              const std::string& lemma)
+    {
+      if (auto lemmaStore = weakStore.lock())
+        lemmaStore->append(key, lemma);
+    });
+    state_->setLemmaStore(std::move(lemmaStore));
+  }
+  catch (const std::exception& exception)
+  {
+    std::cout << "> Lemma store disabled: " << exception.what() << "\n";
+  }
+}
+
+void LemmatizerLoader::closeLemmaStore()
+{
+  state_->setLemmaStore(nullptr);
+  destroyWhenReleased(storeReleased_);
+}
+
+void LemmatizerLoader::warmUp(LemmatizerPool& lemmatizerPool, LemmaCache* lemmaCache) const
+{
+  std::cout << "> Warming up...\n";
+  const size_t warmupThreadCount = config_.warmupThreadCount > 0 ? config_.warmupThreadCount
+                                                                 : config_.lemmatizerCount;
+  const auto summary = cache_warmup::warmUp(config_.warmupCorpusPaths,
+                                            lemmatizerPool,
+                                            lemmaCache,
+                                            warmupThreadCount,
+                                            std::chrono::seconds(config_.warmupSeconds));
+  std::cout << "> Warm-up processed " << summary.processedDocs << "/" << summary.loadedDocs
+            << " doc(s)" << (summary.timedOut ? " before running out of time" : "") << "\n";
+}
+
+std::optional<uint64_t> LemmatizerLoader::dictionaryFingerprint() const
+{
+  if (config_.dictionaryPrefetchPaths.empty() && config_.dictionaryVersion.empty())
+    return std::nullopt;
+  return LemmaStore::dictionaryFingerprint(config_.dictionaryPrefetchPaths,
+                                           config_.dictionaryVersion);
+}
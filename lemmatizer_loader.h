@@ -0,0 +1,56 @@
+#ifndef LEMMATIZER_LOADER_H
+#define LEMMATIZER_LOADER_H
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <optional>
+
+#include "server_config.h"
+
+class LemmaCache;
+class LemmaStore;
+class LemmatizerPool;
+class ServiceState;
+
+// Assembles the lemmatizers, restores and warms the lemma cache and publishes the result to the
+// service state; afterwards assembles a fresh set whenever a reload is requested, keeping the
+// cache unless the dictionaries changed or can't be identified. In prefork mode every lemmatizer
+// is assembled up front, to be shared by the workers, and the lemma store is only read, since
+// its writer thread wouldn't survive the fork.
+class LemmatizerLoader
+{
+public:
+  LemmatizerLoader(ServerConfig config, std::shared_ptr<ServiceState> state);
+  ~LemmatizerLoader();
+
+  // Blocks forever; meant to be run on its own thread.
+  void run();
+
+  // The steps of run(), for the prefork supervisor, which loads before forking and reloads on
+  // SIGHUP on its only thread.
+  void load();
+  void reload();
+
+private:
+
+  void prefetchDictionaries() const;
+  std::shared_ptr<LemmatizerPool> assembleLemmatizerPool(
+      size_t preassembledLemmatizerCount,
+      std::future<std::unique_ptr<LemmatizerPool>>& released) const;
+  void openLemmaStore(const std::shared_ptr<LemmaCache>& lemmaCache);
+  void closeLemmaStore();
+  void warmUp(LemmatizerPool& lemmatizerPool, LemmaCache* lemmaCache) const;
+  // None if neither --dictionary-version nor --prefetch-dictionaries identifies them.
+  std::optional<uint64_t> dictionaryFingerprint() const;
+  bool isPrefork() const { return config_.workerCount > 0; }
+
+  const ServerConfig config_;
+  const std::shared_ptr<ServiceState> state_;
+  std::optional<uint64_t> dictionaryFingerprint_;
+  // Ready once nobody uses the published pool or store any more.
+  std::future<std::unique_ptr<LemmatizerPool>> poolReleased_;
+  std::future<std::unique_ptr<LemmaStore>> storeReleased_;
+};
+
+#endif // LEMMATIZER_LOADER_H
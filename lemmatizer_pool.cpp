@@ -0,0 +1,146 @@
+#include "lemmatizer_pool.h"
+
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+#include <utility>
+
+#include <polem-dev/CascadeLemmatizer.h>
+
+LemmatizerPool::Lease::Lease(LemmatizerPool& pool,
+                             std::unique_ptr<CascadeLemmatizer> lemmatizer,
+                             std::chrono::microseconds waitTime)
+  : pool_(&pool), lemmatizer_(std::move(lemmatizer)), waitTime_(waitTime)
+{
+}
+
+LemmatizerPool::Lease::Lease(Lease&& other) noexcept
+  : pool_(other.pool_), lemmatizer_(std::move(other.lemmatizer_)), waitTime_(other.waitTime_)
+{
+}
+
+LemmatizerPool::Lease::~Lease()
+{
+  if (lemmatizer_)
+    pool_->release(std::move(lemmatizer_));
+}
+
+LemmatizerPool::LemmatizerPool(size_t capacity, size_t initialSize)
+  : LemmatizerPool(capacity, initialSize, assembleLemmatizer)
+{
+}
+
+LemmatizerPool::LemmatizerPool(size_t capacity, size_t initialSize, Factory factory)
+  : factory_(std::move(factory))
+{
+  if (capacity == 0)
+    throw std::invalid_argument("Lemmatizer pool capacity must be greater than 0");
+  if (initialSize > capacity)
+    throw std::invalid_argument("Lemmatizer pool initial size exceeds its capacity");
+
+  // Assembling loads all of Polem's dictionaries, so the instances are built in parallel.
+  std::vector<std::future<std::unique_ptr<CascadeLemmatizer>>> assemblies;
+  for (size_t i = 0; i < initialSize; ++i)
+    assemblies.push_back(std::async(std::launch::async, factory_));
+
+  for (auto& assembly : assemblies)
+    idleLemmatizers_.push_back(assembly.get());
+
+  statistics_.capacity = capacity;
+  statistics_.size = initialSize;
+}
+
+LemmatizerPool::~LemmatizerPool()
+{
+  for (auto& assemblyThread : assemblyThreads_)
+    assemblyThread.join();
+}
+
+LemmatizerPool::Lease LemmatizerPool::acquire()
+{
+  const auto waitStart = std::chrono::steady_clock::now();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++statistics_.waiting;
+  while (idleLemmatizers_.empty())
+  {
+    if (assemblyError_ && statistics_.inUse == 0 && runningAssemblies_ == 0)
+    {
+      // The error is reported once, so the next request retries the assembly.
+      --statistics_.waiting;
+      std::rethrow_exception(std::exchange(assemblyError_, nullptr));
+    }
+    // One assembly per waiting request at most, and the request takes whichever lemmatizer is
+    // free first, so a burst doesn't assemble more than it needs.
+    if (statistics_.size < statistics_.capacity && runningAssemblies_ < statistics_.waiting)
+      startAssembly();
+    lemmatizerReleased_.wait(lock);
+  }
+  --statistics_.waiting;
+
+  auto lemmatizer = std::move(idleLemmatizers_.back());
+  idleLemmatizers_.pop_back();
+
+  const auto waitTime = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - waitStart);
+  ++statistics_.inUse;
+  ++statistics_.acquisitions;
+  statistics_.totalWaitTime += waitTime;
+  statistics_.maxWaitTime = std::max(statistics_.maxWaitTime, waitTime);
+
+  return Lease(*this, std::move(lemmatizer), waitTime);
+}
+
+LemmatizerPool::Statistics LemmatizerPool::statistics() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+std::unique_ptr<CascadeLemmatizer> LemmatizerPool::assembleLemmatizer()
+{
+  return std::make_unique<CascadeLemmatizer>(CascadeLemmatizer::assembleLemmatizer());
+}
+
+void LemmatizerPool::startAssembly()
+{
+  // The slot is reserved up front, so concurrent callers don't overshoot the capacity.
+  ++statistics_.size;
+  ++runningAssemblies_;
+  assemblyThreads_.emplace_back([this]{ assembleAdditionalLemmatizer(); });
+}
+
+void LemmatizerPool::assembleAdditionalLemmatizer()
+{
+  std::unique_ptr<CascadeLemmatizer> lemmatizer;
+  std::exception_ptr error;
+  try
+  {
+    lemmatizer = factory_();
+  }
+  catch (...)
+  {
+    error = std::current_exception();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --runningAssemblies_;
+    assemblyError_ = error;
+    if (lemmatizer)
+      idleLemmatizers_.push_back(std::move(lemmatizer));
+    else
+      --statistics_.size;
+  }
+  lemmatizerReleased_.notify_all();
+}
+
+void LemmatizerPool::release(std::unique_ptr<CascadeLemmatizer> lemmatizer)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idleLemmatizers_.push_back(std::move(lemmatizer));
+    --statistics_.inUse;
+  }
+  lemmatizerReleased_.notify_one();
+}
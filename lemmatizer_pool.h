@@ -0,0 +1,92 @@
+#ifndef LEMMATIZER_POOL_H
+#define LEMMATIZER_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CascadeLemmatizer;
+
+class LemmatizerPool
+{
+public:
+  using Factory = std::function<std::unique_ptr<CascadeLemmatizer>()>;
+
+  class Lease
+  {
+  public:
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&&) = delete;
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease();
+
+    CascadeLemmatizer& operator*() const { return *lemmatizer_; }
+    CascadeLemmatizer* operator->() const { return lemmatizer_.get(); }
+    std::chrono::microseconds waitTime() const { return waitTime_; }
+
+  private:
+    friend class LemmatizerPool;
+    Lease(LemmatizerPool& pool,
+          std::unique_ptr<CascadeLemmatizer> lemmatizer,
+          std::chrono::microseconds waitTime);
+
+    LemmatizerPool* pool_;
+    std::unique_ptr<CascadeLemmatizer> lemmatizer_;
+    std::chrono::microseconds waitTime_;
+  };
+
+  struct Statistics
+  {
+    size_t capacity = 0;
+    size_t size = 0;
+    size_t inUse = 0;
+    size_t waiting = 0;
+    uint64_t acquisitions = 0;
+    std::chrono::microseconds totalWaitTime {0};
+    std::chrono::microseconds maxWaitTime {0};
+  };
+
+  // Up to `capacity` lemmatizers are assembled, `initialSize` of them up front and the rest
+  // only when every existing one is checked out, so memory follows the peak concurrency seen so
+  // far rather than the number of server threads. It doesn't go down again: lemmatizers are
+  // kept until the pool is destroyed, and under sustained load the pool reaches `capacity`.
+  // Additional lemmatizers are assembled on threads of the pool; a request that finds none idle
+  // waits for the first one free, released or newly assembled, instead of assembling its own.
+  LemmatizerPool(size_t capacity, size_t initialSize);
+  LemmatizerPool(size_t capacity, size_t initialSize, Factory factory);
+  // Waits for the assemblies still running.
+  ~LemmatizerPool();
+  LemmatizerPool(const LemmatizerPool&) = delete;
+  LemmatizerPool& operator=(const LemmatizerPool&) = delete;
+
+  // Throws the assembly's exception if no lemmatizer could be assembled and none is in use.
+  Lease acquire();
+  Statistics statistics() const;
+
+  static std::unique_ptr<CascadeLemmatizer> assembleLemmatizer();
+
+private:
+  void startAssembly();
+  void assembleAdditionalLemmatizer();
+  void release(std::unique_ptr<CascadeLemmatizer> lemmatizer);
+
+  const Factory factory_;
+  mutable std::mutex mutex_;
+  // Notified when a lemmatizer becomes idle or an assembly fails.
+  std::condition_variable lemmatizerReleased_;
+  std::vector<std::unique_ptr<CascadeLemmatizer>> idleLemmatizers_;
+  Statistics statistics_;
+  size_t runningAssemblies_ = 0;
+  // Of the last assembly, if it failed.
+  std::exception_ptr assemblyError_;
+  std::vector<std::thread> assemblyThreads_;
+};
+
+#endif // LEMMATIZER_POOL_H
@@ -1,31 +1,257 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
 
 #include <pistache/endpoint.h>
 
+#include "admission_controller.h"
+#include "head_filtering_handler.h"
+#include "job_manager.h"
+#include "lemma_cache.h"
+#include "lemma_store.h"
+#include "lemmatizer_loader.h"
+#include "prefork_supervisor.h"
 #include "rest_request_handler.h"
+#include "server_config.h"
+#include "service_state.h"
+#include "work_stealing_pool.h"
 
 using namespace Pistache;
 
-int main()
+namespace
 {
-  std::cout << "> Starting the server...\n";
 
-  Address address(Ipv4::any(), Port(5000));
+sigset_t blockControlSignals()
+{
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGHUP);
+  sigaddset(&signals, SIGCHLD);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  return signals;
+}
+
+std::shared_ptr<ServiceState> makeServiceState(const ServerConfig& config)
+{
+  std::shared_ptr<LemmaCache> lemmaCache;
+  if (config.lemmaCacheBytes > 0)
+    lemmaCache = std::make_shared<LemmaCache>(config.lemmaCacheBytes);
+  return std::make_shared<ServiceState>(lemmaCache);
+}
+
+using Servers = std::vector<std::unique_ptr<Http::Endpoint>>;
+
+// Longest a shutdown waits for the admitted requests to finish.
+constexpr auto maxDrainTime = std::chrono::seconds(30);
+
+// A leftover socket file from an earlier run would make binding the path fail.
+void removeStaleUnixSocket(const std::filesystem::path& path)
+{
+  std::error_code error;
+  if (std::filesystem::is_socket(path, error))
+    std::filesystem::remove(path, error);
+}
 
-  const int serverThreadCount = 1;
-  const int maxRequestBytes = 1024*1024;
-  const int maxResponseBytes = 1024*1024;
+// The TCP listener and/or the Unix domain socket one, serving the same handler. With
+// `sharePort`, other processes may listen on the same TCP port, and the kernel spreads the
+// connections between them.
+Servers startServers(const ServerConfig& config,
+                     const std::shared_ptr<ServiceState>& state,
+                     const std::shared_ptr<AdmissionController>& admission,
+                     bool sharePort)
+{
+  std::cout << "> Using " << config.threadCount << " server thread(s) per listener, "
+            << config.computeThreadCount << " compute thread(s) and up to "
+            << config.lemmatizerCount << " lemmatizer(s)\n";
+  std::cout << "> Admitting up to " << config.admissionQueueBytes
+            << " request bytes for lemmatization at a time\n";
+  // Pistache has one limit for all requests; the handler's head filter applies the smaller one
+  // to every other resource than jobs, chunked bodies included.
+  const bool acceptsJobs = !config.jobDirectory.empty();
   auto options = Http::Endpoint::options()
-      .threads(serverThreadCount)
-      .maxRequestSize(maxRequestBytes)
-      .maxResponseSize(maxResponseBytes);
+      .threads(static_cast<int>(config.threadCount))
+      .maxRequestSize(acceptsJobs ? std::max(config.maxRequestBytes, config.maxJobBytes)
+                                  : config.maxRequestBytes)
+      .maxResponseSize(config.maxResponseBytes);
+
+  auto computePool = std::make_shared<WorkStealingPool>(config.computeThreadCount);
+  std::shared_ptr<JobManager> jobs;
+  if (acceptsJobs)
+  {
+    jobs = std::make_shared<JobManager>(config.jobDirectory, config.jobThreadCount,
+                                        std::chrono::seconds(config.jobRetentionSeconds), state);
+    std::cout << "> Accepting jobs of up to " << config.maxJobBytes << " bytes, spooled to "
+              << config.jobDirectory << "\n";
+  }
+  const auto startServer = [&](const Address& address, const decltype(options)& serverOptions)
+  {
+    auto server = std::make_unique<Http::Endpoint>(address);
+    server->init(serverOptions);
+    server->setHandler(Http::make_handler<HeadFilteringHandler>(
+          std::make_shared<RestRequestHandler>(state, computePool, admission, jobs, config)));
+    server->serveThreaded();
+    return server;
+  };
+
+  Servers servers;
+  if (config.port != 0)
+  {
+    auto tcpOptions = options;
+    if (sharePort)
+      tcpOptions = tcpOptions.flags(Tcp::Options::ReuseAddr | Tcp::Options::ReusePort);
+    servers.push_back(startServer(Address(Ipv4::any(), Port(config.port)), tcpOptions));
+    std::cout << "> Listening on port " << config.port << "\n";
+  }
+  if (!config.unixSocketPath.empty())
+  {
+    // Pistache takes an address containing a '/' for a Unix domain socket path.
+    const auto socketPath = std::filesystem::absolute(config.unixSocketPath);
+    removeStaleUnixSocket(socketPath);
+    servers.push_back(startServer(Address(socketPath.string()), options));
+    std::cout << "> Listening on " << socketPath << "\n";
+  }
+  return servers;
+}
+
+// Returns on SIGINT or SIGTERM.
+void waitForShutdownSignal(const sigset_t& controlSignals, const std::function<void()>& onReload)
+{
+  int signal = 0;
+  while (sigwait(&controlSignals, &signal) == 0)
+  {
+    if (signal == SIGHUP)
+      onReload();
+    else if (signal == SIGINT || signal == SIGTERM)
+      return;
+  }
+}
+
+void shutDown(Servers& servers,
+              const ServerConfig& config,
+              const ServiceState& state,
+              AdmissionController& admission)
+{
+  std::cout << "> Shutting down...\n";
+  // The admitted requests are finished and answered first, so that a worker retired after a
+  // reload drops none of them. New ones are refused with 503 meanwhile, or the drain would never
+  // end under load; in prefork mode the other workers take them over.
+  admission.close();
+  const auto drainDeadline = std::chrono::steady_clock::now() + maxDrainTime;
+  while (admission.statistics().requests > 0 && std::chrono::steady_clock::now() < drainDeadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
 
-  Http::Endpoint server(address);
-  server.init(options);
-  server.setHandler(Http::make_handler<RestRequestHandler>());
+  for (auto& server : servers)
+    server->shutdown();
+  if (!config.unixSocketPath.empty())
+    removeStaleUnixSocket(std::filesystem::absolute(config.unixSocketPath));
+  if (auto lemmaStore = state.lemmaStore())
+    lemmaStore->flush();
+}
+
+int runSingleProcess(const ServerConfig& config, const sigset_t& controlSignals)
+{
+  auto state = makeServiceState(config);
 
-  std::cout << "> Ready to serve!\n";
-  server.serve();
+  // The port is open and /healthz, /readyz answer while the lemmatizer is being loaded;
+  // lemmatization requests get 503 until it's ready.
+  auto admission = std::make_shared<AdmissionController>(config.admissionQueueBytes);
+  auto servers = startServers(config, state, admission, false);
 
+  // Detached so that a shutdown signal doesn't have to wait for loading or a reload to finish.
+  auto loader = std::make_shared<LemmatizerLoader>(config, state);
+  std::thread([loader]{ loader->run(); }).detach();
+
+  waitForShutdownSignal(controlSignals, [&state]
+  {
+    if (!state->requestReload())
+      std::cout << "> Reload already in progress\n";
+  });
+
+  shutDown(servers, config, *state, *admission);
+  return 0;
+}
+
+int runWorker(const ServerConfig& config,
+              const std::shared_ptr<ServiceState>& state,
+              const sigset_t& controlSignals,
+              const std::function<void()>& ready)
+{
+  auto admission = std::make_shared<AdmissionController>(config.admissionQueueBytes);
+  auto servers = startServers(config, state, admission, true);
+  ready();
+
+  // Reloading is the supervisor's job: it reloads once and replaces all the workers. Reload
+  // requests made to a worker, by /admin/reload or SIGHUP, are passed on to it.
+  const pid_t supervisorPid = getppid();
+  std::thread([state, supervisorPid]
+  {
+    while (true)
+    {
+      state->waitForReloadRequest();
+      kill(supervisorPid, SIGHUP);
+      state->finishReload();
+    }
+  }).detach();
+
+  waitForShutdownSignal(controlSignals, [supervisorPid]{ kill(supervisorPid, SIGHUP); });
+
+  shutDown(servers, config, *state, *admission);
   return 0;
 }
+
+int runPrefork(const ServerConfig& config, const sigset_t& controlSignals)
+{
+  // Loaded before forking, so that the workers share the dictionaries copy-on-write instead of
+  // holding a copy each.
+  auto state = makeServiceState(config);
+  LemmatizerLoader loader(config, state);
+  loader.load();
+  if (!state->isReady())
+    return 1;
+
+  std::cout << "> Starting " << config.workerCount << " worker(s)...\n";
+  const auto workerMain = [&config, &state, &controlSignals](const std::function<void()>& ready)
+  {
+    return runWorker(config, state, controlSignals, ready);
+  };
+  PreforkSupervisor supervisor(config.workerCount, workerMain);
+  supervisor.run(controlSignals, [&loader]{ loader.reload(); });
+  return 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  ServerConfig config;
+  try
+  {
+    config = server_config::parseCommandLine(argc, argv);
+    server_config::resolveAutomaticSizes(config);
+  }
+  catch (const std::invalid_argument& exception)
+  {
+    std::cerr << exception.what() << "\n" << server_config::usage(argv[0]);
+    return 1;
+  }
+
+  // Blocked before any thread is started, so that only the main thread's sigwait sees them.
+  const sigset_t controlSignals = blockControlSignals();
+
+  std::cout << "> Starting the server...\n";
+
+  if (config.workerCount > 0)
+    return runPrefork(config, controlSignals);
+  return runSingleProcess(config, controlSignals);
+}
@@ -0,0 +1,42 @@
+#include "ndjson_processing.h"
+
+#include "nlohmann_json/json.hpp"
+
+#include "label_processing.h"
+#include "lemmatizer_pool.h"
+
+using Json = nlohmann::json;
+
+namespace ndjson_processing
+{
+
+bool isBlank(std::string_view line)
+{
+  return line.find_first_not_of(" \t\r") == std::string_view::npos;
+}
+
+bool lemmatizeLine(std::string_view line,
+                   size_t lineNumber,
+                   LemmatizerPool& lemmatizerPool,
+                   LemmaCache* lemmaCache,
+                   std::string& outputLine)
+{
+  try
+  {
+    Json doc = Json::parse(line.begin(), line.end());
+    {
+      auto lemmatizer = lemmatizerPool.acquire();
+      label_processing::findAndLemmatizeNerLabelsInDoc(doc, *lemmatizer, lemmaCache);
+    }
+    outputLine = doc.dump();
+    return true;
+  }
+  catch (const std::exception& exception)
+  {
+    const Json error = {{"error", exception.what()}, {"line", lineNumber}};
+    outputLine = error.dump(-1, ' ', false, Json::error_handler_t::replace);
+    return false;
+  }
+}
+
+}
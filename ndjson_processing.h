@@ -0,0 +1,28 @@
+#ifndef NDJSON_PROCESSING_H
+#define NDJSON_PROCESSING_H
+
+#include <string>
+#include <string_view>
+
+class LemmaCache;
+class LemmatizerPool;
+
+// Lemmatization of newline-delimited JSON, one doc per line, shared by the streaming endpoint
+// and the jobs API.
+namespace ndjson_processing
+{
+
+bool isBlank(std::string_view line);
+
+// Writes the lemmatized doc of `line` to `outputLine`, without a newline, leasing a lemmatizer
+// for just this doc. A line that can't be processed gives {"error": ..., "line": lineNumber}
+// instead, and false.
+bool lemmatizeLine(std::string_view line,
+                   size_t lineNumber,
+                   LemmatizerPool& lemmatizerPool,
+                   LemmaCache* lemmaCache,
+                   std::string& outputLine);
+
+}
+
+#endif // NDJSON_PROCESSING_H
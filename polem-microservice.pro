@@ -4,14 +4,56 @@ CONFIG -= app_bundle
 CONFIG -= qt
 
 SOURCES += \
+        admission_controller.cpp \
+        body_codec.cpp \
+        cache_warmup.cpp \
+        content_negotiation.cpp \
+        dictionary_prefetch.cpp \
+        head_filtering_handler.cpp \
+        job_manager.cpp \
+        json_output.cpp \
         label_processing.cpp \
+        lemma_cache.cpp \
+        lemma_store.cpp \
+        lemmatizer_loader.cpp \
+        lemmatizer_pool.cpp \
         main.cpp \
-        rest_request_handler.cpp
+        ndjson_processing.cpp \
+        prefork_supervisor.cpp \
+        request_head_filter.cpp \
+        request_headers.cpp \
+        response_output.cpp \
+        rest_request_handler.cpp \
+        server_config.cpp \
+        service_state.cpp \
+        wire_format.cpp \
+        work_stealing_pool.cpp
 
 HEADERS += \
+  admission_controller.h \
+  body_codec.h \
+  cache_warmup.h \
+  content_negotiation.h \
+  dictionary_prefetch.h \
+  head_filtering_handler.h \
   disk_input.h \
+  job_manager.h \
+  json_output.h \
   label_processing.h \
-  rest_request_handler.h
+  lemma_cache.h \
+  lemma_store.h \
+  lemmatizer_loader.h \
+  lemmatizer_pool.h \
+  ndjson_processing.h \
+  prefork_supervisor.h \
+  request_head_filter.h \
+  request_headers.h \
+  response_output.h \
+  rest_request_handler.h \
+  server_config.h \
+  service_state.h \
+  wire_format.h \
+  work_stealing_pool.h
 
 unix: LIBS += -L$$PWD/../../../usr/local/lib/ -lpolem-dev
 INCLUDEPATH += $$PWD/../../../usr/local/include
@@ -23,4 +65,10 @@ INCLUDEPATH += $$PWD/../../../usr/include/pistache
 DEPENDPATH += $$PWD/../../../usr/include/pistache
 unix: LIBS += -L$$PWD/../../../usr/lib/x86_64-linux-gnu/ -lpistache
 
-unix: LIBS += -lpthread -lssl -lcrypto
+unix: LIBS += -lpthread -lssl -lcrypto -lz
+
+# zstd content coding; enable with `qmake CONFIG+=with_zstd`
+with_zstd {
+  DEFINES += WITH_ZSTD
+  LIBS += -lzstd
+}
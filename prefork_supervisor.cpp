@@ -0,0 +1,277 @@
+#include "prefork_supervisor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+
+// A worker that dies sooner than this after its start is restarted only after a pause, so that
+// one failing at startup doesn't make the supervisor fork in a tight loop. The pause is a
+// deadline of the event loop, so signals are still handled meanwhile.
+constexpr auto minWorkerLifetime = std::chrono::seconds(1);
+constexpr auto restartDelay = std::chrono::seconds(1);
+
+std::string describeExit(int status)
+{
+  if (WIFSIGNALED(status))
+    return "was killed by signal " + std::to_string(WTERMSIG(status));
+  return "exited with status " + std::to_string(WEXITSTATUS(status));
+}
+
+}
+
+PreforkSupervisor::PreforkSupervisor(size_t workerCount, WorkerMain workerMain)
+  : workerCount_(workerCount), workerMain_(std::move(workerMain)), supervisorPid_(getpid())
+{
+}
+
+PreforkSupervisor::~PreforkSupervisor()
+{
+  for (const int fd : {signalFd_, readyPipe_[0], readyPipe_[1]})
+  {
+    if (fd >= 0)
+      close(fd);
+  }
+}
+
+void PreforkSupervisor::run(const sigset_t& controlSignals, const std::function<void()>& reload)
+{
+  signalFd_ = signalfd(-1, &controlSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signalFd_ < 0 || pipe2(readyPipe_, O_NONBLOCK | O_CLOEXEC) != 0)
+    throw std::runtime_error(std::string("Failed to set up the supervisor: ")
+                             + std::strerror(errno));
+
+  for (size_t i = 0; i < workerCount_; ++i)
+    startWorker();
+
+  pollfd events[] = {{signalFd_, POLLIN, 0}, {readyPipe_[0], POLLIN, 0}};
+  bool stopping = false;
+  while (!stopping)
+  {
+    if (poll(events, 2, millisecondsToNextStart()) < 0 && errno != EINTR)
+      break;
+
+    if (events[1].revents & POLLIN)
+      readReadyWorkers();
+
+    signalfd_siginfo signal;
+    while (!stopping && read(signalFd_, &signal, sizeof signal) == sizeof signal)
+    {
+      if (signal.ssi_signo == SIGCHLD)
+      {
+        reapWorkers();
+      }
+      else if (signal.ssi_signo == SIGHUP)
+      {
+        reload();
+        queueReplacements();
+      }
+      else if (signal.ssi_signo == SIGINT || signal.ssi_signo == SIGTERM)
+      {
+        stopping = true;
+      }
+    }
+
+    if (!stopping)
+      startDueWorkers();
+  }
+
+  stopWorkers();
+}
+
+pid_t PreforkSupervisor::startWorker()
+{
+  // Anything still buffered would otherwise be written by the worker as well.
+  std::cout.flush();
+
+  const pid_t pid = fork();
+  if (pid < 0)
+  {
+    std::cout << "> Failed to start a worker: " << std::strerror(errno) << "\n";
+    return 0;
+  }
+
+  if (pid == 0)
+  {
+    // Workers don't outlive the supervisor, even if it's killed.
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != supervisorPid_)
+      _exit(1);
+
+    close(signalFd_);
+    close(readyPipe_[0]);
+    const int readyFd = readyPipe_[1];
+    const int status = workerMain_([readyFd]
+    {
+      // Shorter than PIPE_BUF, so written at once even when workers report together.
+      const pid_t workerPid = getpid();
+      if (write(readyFd, &workerPid, sizeof workerPid) != sizeof workerPid)
+        std::cout << "> Failed to report the worker ready: " << std::strerror(errno) << "\n";
+    });
+    std::cout.flush();
+    _exit(status);
+  }
+
+  workers_[pid] = Clock::now();
+  std::cout << "> Started worker " << pid << "\n";
+  return pid;
+}
+
+void PreforkSupervisor::reapWorkers()
+{
+  int status = 0;
+  pid_t pid = 0;
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+  {
+    const auto worker = workers_.find(pid);
+    if (worker == workers_.end())
+      continue;
+
+    const auto lifetime = Clock::now() - worker->second;
+    workers_.erase(worker);
+    if (retiringWorkers_.erase(pid) > 0)
+      continue;
+
+    if (pid == replacementPid_)
+    {
+      // The worker it was to replace keeps serving; the replacement is tried again later.
+      std::cout << "> Worker " << pid << " " << describeExit(status)
+                << " before it was ready, retrying\n";
+      replacementPid_ = 0;
+      replacementTime_ = Clock::now() + restartDelay;
+      continue;
+    }
+
+    const auto queued = std::find(workersToReplace_.begin(), workersToReplace_.end(), pid);
+    if (queued == workersToReplace_.begin() && replacementPid_ != 0)
+    {
+      // Its replacement is already on the way.
+      std::cout << "> Worker " << pid << " " << describeExit(status) << "\n";
+      *queued = 0;
+      continue;
+    }
+    if (queued != workersToReplace_.end())
+      workersToReplace_.erase(queued);
+
+    std::cout << "> Worker " << pid << " " << describeExit(status) << ", restarting it\n";
+    if (lifetime < minWorkerLifetime)
+      restartTimes_.push_back(Clock::now() + restartDelay);
+    else
+      startWorker();
+  }
+}
+
+void PreforkSupervisor::readReadyWorkers()
+{
+  pid_t pids[64];
+  ssize_t size = 0;
+  while ((size = read(readyPipe_[0], pids, sizeof pids)) > 0)
+  {
+    for (size_t i = 0; i < static_cast<size_t>(size) / sizeof(pid_t); ++i)
+    {
+      if (pids[i] == replacementPid_)
+      {
+        replacementPid_ = 0;
+        const pid_t previousPid = workersToReplace_.front();
+        workersToReplace_.pop_front();
+        retireWorker(previousPid);
+        replaceNextWorker();
+      }
+    }
+  }
+}
+
+void PreforkSupervisor::startDueWorkers()
+{
+  const auto now = Clock::now();
+  const auto due = std::partition(restartTimes_.begin(), restartTimes_.end(),
+                                  [now](Clock::time_point time) { return time > now; });
+  const auto dueCount = std::distance(due, restartTimes_.end());
+  restartTimes_.erase(due, restartTimes_.end());
+  for (auto i = 0; i < dueCount; ++i)
+    startWorker();
+
+  if (replacementTime_ && *replacementTime_ <= now)
+  {
+    replacementTime_.reset();
+    replaceNextWorker();
+  }
+}
+
+int PreforkSupervisor::millisecondsToNextStart() const
+{
+  std::optional<Clock::time_point> next = replacementTime_;
+  for (const auto time : restartTimes_)
+    next = next ? std::min(*next, time) : time;
+  if (!next)
+    return -1;
+
+  const auto wait = std::chrono::ceil<std::chrono::milliseconds>(*next - Clock::now());
+  return static_cast<int>(std::max<std::chrono::milliseconds::rep>(wait.count(), 0));
+}
+
+void PreforkSupervisor::queueReplacements()
+{
+  // A replacement under way goes on; every other worker, including that replacement, was
+  // forked before this reload and is replaced after it.
+  std::deque<pid_t> workersToReplace;
+  if (replacementPid_ != 0)
+    workersToReplace.push_back(workersToReplace_.front());
+  for (const auto& [pid, startTime] : workers_)
+  {
+    if (retiringWorkers_.count(pid) == 0
+        && (workersToReplace.empty() || pid != workersToReplace.front()))
+      workersToReplace.push_back(pid);
+  }
+  workersToReplace_ = std::move(workersToReplace);
+  replaceNextWorker();
+}
+
+void PreforkSupervisor::replaceNextWorker()
+{
+  // One at a time, and the previous worker exits only once its replacement is serving, so that
+  // the port is served throughout.
+  if (replacementPid_ != 0 || replacementTime_ || workersToReplace_.empty())
+    return;
+
+  replacementPid_ = startWorker();
+  if (replacementPid_ == 0)
+    replacementTime_ = Clock::now() + restartDelay;
+}
+
+void PreforkSupervisor::retireWorker(pid_t pid)
+{
+  if (pid == 0 || workers_.count(pid) == 0)
+    return;
+  // The worker finishes the requests it has admitted before it exits.
+  retiringWorkers_.insert(pid);
+  kill(pid, SIGTERM);
+}
+
+void PreforkSupervisor::stopWorkers()
+{
+  std::cout << "> Stopping " << workers_.size() << " worker(s)...\n";
+  for (const auto& [pid, startTime] : workers_)
+    kill(pid, SIGTERM);
+
+  for (const auto& [pid, startTime] : workers_)
+    waitpid(pid, nullptr, 0);
+  workers_.clear();
+  retiringWorkers_.clear();
+  restartTimes_.clear();
+  workersToReplace_.clear();
+  replacementPid_ = 0;
+  replacementTime_.reset();
+}
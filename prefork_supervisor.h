@@ -0,0 +1,70 @@
+#ifndef PREFORK_SUPERVISOR_H
+#define PREFORK_SUPERVISOR_H
+
+#include <chrono>
+#include <csignal>
+#include <deque>
+#include <functional>
+#include <map>
+#include <optional>
+#include <set>
+#include <vector>
+
+#include <sys/types.h>
+
+// Parent of the prefork mode: forks worker processes that inherit everything the parent has
+// loaded, the lemmatizer included, sharing its pages copy-on-write, and keeps their number up.
+// A worker that dies is replaced by a fresh fork of the parent, so nothing is loaded again.
+// The parent must not have any other threads running, since only the forking thread survives
+// in the child.
+class PreforkSupervisor
+{
+public:
+  // Runs in a forked worker; its result is the worker's exit status. The worker calls `ready`
+  // once it is serving, which lets the worker it replaces after a reload exit.
+  using WorkerMain = std::function<int(const std::function<void()>& ready)>;
+
+  PreforkSupervisor(size_t workerCount, WorkerMain workerMain);
+  ~PreforkSupervisor();
+
+  // Starts the workers and handles `controlSignals`, which must be blocked and include SIGCHLD,
+  // until SIGINT or SIGTERM, which stops the workers. SIGHUP calls `reload` and then replaces
+  // the workers one by one.
+  void run(const sigset_t& controlSignals, const std::function<void()>& reload);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  // The pid of the new worker, or 0 if it couldn't be forked.
+  pid_t startWorker();
+  void reapWorkers();
+  void readReadyWorkers();
+  void startDueWorkers();
+  // Milliseconds until the next scheduled start, -1 if none is.
+  int millisecondsToNextStart() const;
+  void queueReplacements();
+  void replaceNextWorker();
+  void retireWorker(pid_t pid);
+  void stopWorkers();
+
+  const size_t workerCount_;
+  const WorkerMain workerMain_;
+  const pid_t supervisorPid_;
+  int signalFd_ = -1;
+  // Workers write their pid here when they are ready.
+  int readyPipe_[2] = {-1, -1};
+  // Running workers by pid, with their start time.
+  std::map<pid_t, Clock::time_point> workers_;
+  // Workers asked to exit after a reload; they aren't restarted.
+  std::set<pid_t> retiringWorkers_;
+  // When to start workers in place of ones that died soon after starting.
+  std::vector<Clock::time_point> restartTimes_;
+  // Workers still to be replaced after a reload, in order; 0 for one that died meanwhile.
+  std::deque<pid_t> workersToReplace_;
+  // The worker started to replace the first of workersToReplace_, until it is ready.
+  pid_t replacementPid_ = 0;
+  // When to try starting a replacement again after one failed.
+  std::optional<Clock::time_point> replacementTime_;
+};
+
+#endif // PREFORK_SUPERVISOR_H
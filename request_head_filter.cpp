@@ -0,0 +1,315 @@
+#include "request_head_filter.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "content_negotiation.h"
+
+namespace
+{
+
+const std::string_view headTerminator = "\r\n\r\n";
+
+std::string_view trim(std::string_view text)
+{
+  const auto begin = text.find_first_not_of(" \t");
+  if (begin == std::string_view::npos)
+    return {};
+  const auto end = text.find_last_not_of(" \t");
+  return text.substr(begin, end - begin + 1);
+}
+
+std::optional<RequestHead> parseHead(std::string_view text)
+{
+  // Empty lines before a request line are allowed and ignored.
+  while (text.substr(0, 2) == "\r\n")
+    text.remove_prefix(2);
+
+  RequestHead head;
+  auto lineEnd = text.find("\r\n");
+  const auto requestLine = text.substr(0, lineEnd);
+  const auto methodEnd = requestLine.find(' ');
+  const auto targetEnd = requestLine.find(' ', methodEnd == std::string_view::npos
+                                                   ? methodEnd : methodEnd + 1);
+  if (methodEnd == std::string_view::npos || targetEnd == std::string_view::npos)
+    return std::nullopt;
+
+  head.method = std::string(requestLine.substr(0, methodEnd));
+  const auto target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+  head.resource = std::string(target.substr(0, target.find('?')));
+  head.version = std::string(requestLine.substr(targetEnd + 1));
+
+  while (lineEnd != std::string_view::npos)
+  {
+    const auto lineStart = lineEnd + 2;
+    lineEnd = text.find("\r\n", lineStart);
+    const auto line = text.substr(lineStart, lineEnd == std::string_view::npos
+                                                 ? std::string_view::npos : lineEnd - lineStart);
+    if (line.empty())
+      continue;
+
+    const auto separator = line.find(':');
+    if (separator == std::string_view::npos)
+      return std::nullopt;
+    head.headers.emplace_back(std::string(trim(line.substr(0, separator))),
+                              std::string(trim(line.substr(separator + 1))));
+  }
+  return head;
+}
+
+// Moves `data` up to and including the next line feed into `line`; returns true once the line
+// is complete, without its line break.
+bool readLine(std::string_view& data, std::string& line)
+{
+  const auto end = data.find('\n');
+  line.append(data.data(), end == std::string_view::npos ? data.size() : end);
+  data.remove_prefix(end == std::string_view::npos ? data.size() : end + 1);
+  if (end == std::string_view::npos)
+    return false;
+  if (!line.empty() && line.back() == '\r')
+    line.pop_back();
+  return true;
+}
+
+// Whether chunked is the final transfer coding, which alone delimits the body.
+bool isChunked(std::string_view transferEncoding)
+{
+  const auto lastComma = transferEncoding.rfind(',');
+  const auto lastCoding = lastComma == std::string_view::npos
+      ? transferEncoding : transferEncoding.substr(lastComma + 1);
+  return content_negotiation::equalsIgnoringCase(std::string(trim(lastCoding)), "chunked");
+}
+
+std::string reasonPhrase(int statusCode)
+{
+  switch (statusCode)
+  {
+    case 400: return "Bad Request";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 415: return "Unsupported Media Type";
+    case 417: return "Expectation Failed";
+    case 431: return "Request Header Fields Too Large";
+    case 503: return "Service Unavailable";
+    default: return "Error";
+  }
+}
+
+}
+
+std::optional<std::string> RequestHead::header(const std::string& name) const
+{
+  for (const auto& [headerName, value] : headers)
+  {
+    if (content_negotiation::equalsIgnoringCase(headerName, name))
+      return value;
+  }
+  return std::nullopt;
+}
+
+RequestHeadFilter::RequestHeadFilter(size_t maxHeadBytes,
+                                     BodyLimit maxBodyBytes,
+                                     Validator validator)
+  : maxHeadBytes_(maxHeadBytes),
+    maxBodyBytes_(std::move(maxBodyBytes)),
+    validator_(std::move(validator))
+{
+}
+
+RequestHeadFilter::Verdict RequestHeadFilter::consume(std::string_view data)
+{
+  Verdict verdict;
+  verdict.passedBytes = data.size();
+  // Where the head being read started in `data`; 0 when it started in earlier data.
+  size_t headStart = 0;
+  const auto offsetOf = [begin = data.data()](std::string_view rest)
+  {
+    return static_cast<size_t>(rest.data() - begin);
+  };
+
+  while (!data.empty())
+  {
+    switch (state_)
+    {
+      case State::Rejected:
+        return {Action::Discard, {0, {}}, 0};
+
+      case State::SkippingBody:
+      case State::SkippingChunk:
+      {
+        const size_t skipped = std::min(bodyBytesLeft_, data.size());
+        bodyBytesLeft_ -= skipped;
+        data.remove_prefix(skipped);
+        if (bodyBytesLeft_ == 0)
+          state_ = state_ == State::SkippingBody ? State::ReadingHead : State::ReadingChunkSize;
+        break;
+      }
+
+      case State::ReadingChunkSize:
+      case State::ReadingTrailers:
+      {
+        const bool complete = readLine(data, line_);
+        if (line_.size() > maxHeadBytes_)
+          return reject({400, "A chunk size or trailer line exceeds "
+                              + std::to_string(maxHeadBytes_) + " bytes.\n"}, headStart);
+        if (!complete)
+          break;
+
+        if (state_ == State::ReadingChunkSize)
+        {
+          if (auto rejection = readChunkSize(line_))
+            return reject(std::move(*rejection), headStart);
+        }
+        else if (line_.empty())
+        {
+          state_ = State::ReadingHead;
+        }
+        line_.clear();
+        break;
+      }
+
+      case State::ReadingHead:
+      {
+        const size_t previousSize = head_.size();
+        if (previousSize == 0)
+          headStart = offsetOf(data);
+        const size_t searchFrom = previousSize >= headTerminator.size() - 1
+            ? previousSize - (headTerminator.size() - 1) : 0;
+        head_.append(data.data(), std::min(data.size(), maxHeadBytes_ + headTerminator.size()));
+
+        const auto headEnd = head_.find(headTerminator, searchFrom);
+        if (headEnd == std::string::npos)
+        {
+          if (head_.size() > maxHeadBytes_)
+            return reject({431, "The request head exceeds " + std::to_string(maxHeadBytes_)
+                                + " bytes.\n"}, headStart);
+          data = {};
+          break;
+        }
+
+        data.remove_prefix(headEnd + headTerminator.size() - previousSize);
+        const auto head = parseHead(std::string_view(head_).substr(0, headEnd));
+        head_.clear();
+        if (!head)
+          return reject({400, "Malformed request head.\n"}, headStart);
+
+        bool expectsContinue = false;
+        if (auto rejection = judge(*head, expectsContinue))
+          return reject(std::move(*rejection), headStart);
+        if (expectsContinue)
+          verdict.action = Action::PassAndContinue;
+        break;
+      }
+    }
+  }
+  return verdict;
+}
+
+std::string RequestHeadFilter::continueResponse()
+{
+  return "HTTP/1.1 100 Continue\r\n\r\n";
+}
+
+std::string RequestHeadFilter::rejectionResponse(const Rejection& rejection)
+{
+  return "HTTP/1.1 " + std::to_string(rejection.statusCode) + " "
+         + reasonPhrase(rejection.statusCode) + "\r\n"
+         "Content-Type: text/plain\r\n"
+         "Content-Length: " + std::to_string(rejection.message.size()) + "\r\n"
+         "Connection: close\r\n"
+         "\r\n" + rejection.message;
+}
+
+std::optional<Rejection> RequestHeadFilter::judge(const RequestHead& head, bool& expectsContinue)
+{
+  const auto transferEncoding = head.header("Transfer-Encoding");
+  const auto contentLength = head.header("Content-Length");
+  const bool chunked = transferEncoding
+      && !content_negotiation::equalsIgnoringCase(*transferEncoding, "identity");
+  const size_t maxBodyBytes = maxBodyBytes_(head);
+  size_t bodyBytes = 0;
+  if (chunked)
+  {
+    // Nothing else tells where the body ends.
+    if (!isChunked(*transferEncoding))
+      return Rejection{400, "The last transfer coding must be chunked.\n"};
+  }
+  else if (contentLength)
+  {
+    const bool isNumber = !contentLength->empty()
+        && std::all_of(contentLength->begin(), contentLength->end(), [](unsigned char character)
+           {
+             return std::isdigit(character);
+           });
+    if (!isNumber || contentLength->size() > 18)
+      return Rejection{400, "Invalid Content-Length.\n"};
+
+    bodyBytes = std::stoull(*contentLength);
+    if (bodyBytes > maxBodyBytes)
+      return Rejection{413, "The request body exceeds " + std::to_string(maxBodyBytes)
+                            + " bytes.\n"};
+  }
+
+  if (auto rejection = validator_(head))
+    return rejection;
+
+  if (const auto expect = head.header("Expect"))
+  {
+    if (!content_negotiation::equalsIgnoringCase(*expect, "100-continue"))
+      return Rejection{417, "Only \"Expect: 100-continue\" is supported.\n"};
+    // HTTP/1.0 clients don't know interim responses.
+    expectsContinue = head.version != "HTTP/1.0";
+  }
+
+  if (chunked)
+  {
+    maxChunkedBodyBytes_ = maxBodyBytes;
+    chunkedBodyBytes_ = 0;
+    state_ = State::ReadingChunkSize;
+  }
+  else
+  {
+    bodyBytesLeft_ = bodyBytes;
+    state_ = bodyBytes > 0 ? State::SkippingBody : State::ReadingHead;
+  }
+  return std::nullopt;
+}
+
+std::optional<Rejection> RequestHeadFilter::readChunkSize(const std::string& line)
+{
+  // Chunk extensions, after a ';', are ignored.
+  const auto size = trim(std::string_view(line).substr(0, line.find(';')));
+  const bool isNumber = !size.empty() && size.size() <= 15
+      && std::all_of(size.begin(), size.end(), [](unsigned char character)
+         {
+           return std::isxdigit(character);
+         });
+  if (!isNumber)
+    return Rejection{400, "Invalid chunk size.\n"};
+
+  const size_t chunkBytes = std::stoull(std::string(size), nullptr, 16);
+  if (chunkBytes == 0)
+  {
+    state_ = State::ReadingTrailers;
+    return std::nullopt;
+  }
+
+  chunkedBodyBytes_ += chunkBytes;
+  if (chunkedBodyBytes_ > maxChunkedBodyBytes_)
+    return Rejection{413, "The request body exceeds " + std::to_string(maxChunkedBodyBytes_)
+                          + " bytes.\n"};
+  // The data is followed by a line break.
+  bodyBytesLeft_ = chunkBytes + 2;
+  state_ = State::SkippingChunk;
+  return std::nullopt;
+}
+
+RequestHeadFilter::Verdict RequestHeadFilter::reject(Rejection rejection, size_t passedBytes)
+{
+  state_ = State::Rejected;
+  head_.clear();
+  head_.shrink_to_fit();
+  line_.clear();
+  line_.shrink_to_fit();
+  return {Action::Reject, std::move(rejection), passedBytes};
+}
@@ -0,0 +1,101 @@
+#ifndef REQUEST_HEAD_FILTER_H
+#define REQUEST_HEAD_FILTER_H
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Request line and headers of an HTTP/1.1 request, as far as they are needed to judge it before
+// its body arrives.
+struct RequestHead
+{
+  std::string method;
+  // Path without the query string.
+  std::string resource;
+  std::string version;
+  std::vector<std::pair<std::string, std::string>> headers;
+
+  // Value of the first header with this name, compared case-insensitively.
+  std::optional<std::string> header(const std::string& name) const;
+};
+
+struct Rejection
+{
+  int statusCode;
+  std::string message;
+};
+
+// Watches the bytes arriving on one connection and judges every request as soon as its head is
+// complete, so that a request that would be refused anyway is refused before its body is
+// uploaded and buffered, and clients sending "Expect: 100-continue" are told to go ahead only
+// when the request is acceptable. The bytes themselves are not modified; accepted ones still go
+// to the HTTP parser.
+class RequestHeadFilter
+{
+public:
+  using Validator = std::function<std::optional<Rejection>(const RequestHead&)>;
+  // Largest body accepted for the request, which may depend on its resource.
+  using BodyLimit = std::function<size_t(const RequestHead&)>;
+
+  enum class Action
+  {
+    // Hand the bytes to the HTTP parser.
+    Pass,
+    // Send "100 Continue", then hand the bytes to the HTTP parser.
+    PassAndContinue,
+    // Hand the bytes before the rejected request to the HTTP parser, then send `rejection` and
+    // close the connection; the rest is dropped.
+    Reject,
+    // The connection has been rejected; drop the bytes.
+    Discard
+  };
+
+  struct Verdict
+  {
+    Action action = Action::Pass;
+    Rejection rejection {0, {}};
+    // Leading bytes of the consumed data that belong to accepted requests.
+    size_t passedBytes = 0;
+  };
+
+  RequestHeadFilter(size_t maxHeadBytes, BodyLimit maxBodyBytes, Validator validator);
+
+  Verdict consume(std::string_view data);
+
+  static std::string continueResponse();
+  // Complete response with "Connection: close".
+  static std::string rejectionResponse(const Rejection& rejection);
+
+private:
+  enum class State
+  {
+    ReadingHead,
+    SkippingBody,
+    // A chunked body is followed chunk by chunk, so that its size is held to the limit as it
+    // arrives and the next request is found after it.
+    ReadingChunkSize,
+    SkippingChunk,
+    ReadingTrailers,
+    Rejected
+  };
+
+  std::optional<Rejection> judge(const RequestHead& head, bool& expectsContinue);
+  std::optional<Rejection> readChunkSize(const std::string& line);
+  Verdict reject(Rejection rejection, size_t passedBytes);
+
+  const size_t maxHeadBytes_;
+  const BodyLimit maxBodyBytes_;
+  const Validator validator_;
+  State state_ = State::ReadingHead;
+  std::string head_;
+  // The chunk size or trailer line being read.
+  std::string line_;
+  size_t bodyBytesLeft_ = 0;
+  size_t maxChunkedBodyBytes_ = 0;
+  size_t chunkedBodyBytes_ = 0;
+};
+
+#endif // REQUEST_HEAD_FILTER_H
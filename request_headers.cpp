@@ -0,0 +1,79 @@
+#include "request_headers.h"
+
+#include <sstream>
+
+#include "content_negotiation.h"
+
+using namespace Pistache;
+
+namespace request_headers
+{
+
+namespace
+{
+
+const std::string acceptHeader = "Accept";
+
+// The media type of a parsed range without its parameters, e.g. "application/json".
+std::string mediaTypeOf(const Http::Mime::MediaType& media)
+{
+  const std::string range = media.toString();
+  const std::string type = range.substr(0, range.find(';'));
+  const auto end = type.find_last_not_of(" \t");
+  return end == std::string::npos ? std::string() : type.substr(0, end + 1);
+}
+
+std::string mediaRange(const Http::Mime::MediaType& media,
+                       const std::vector<std::string>& parameters)
+{
+  std::ostringstream range;
+  range << mediaTypeOf(media);
+  if (const auto quality = media.q())
+    range << "; q=" << quality->value() / 100.0;
+  for (const auto& parameter : parameters)
+  {
+    if (const auto value = media.getParam(parameter))
+      range << "; " << parameter << "=" << *value;
+  }
+  return range.str();
+}
+
+}
+
+std::optional<std::string> find(const Http::Header::Collection& headers, const std::string& name)
+{
+  for (const auto& header : headers.list())
+  {
+    if (content_negotiation::equalsIgnoringCase(header->name(), name))
+    {
+      std::ostringstream value;
+      header->write(value);
+      return value.str();
+    }
+  }
+  for (const auto& [rawName, header] : headers.rawList())
+  {
+    if (content_negotiation::equalsIgnoringCase(rawName, name))
+      return header.value();
+  }
+  return std::nullopt;
+}
+
+std::string accept(const Http::Header::Collection& headers,
+                   const std::vector<std::string>& parameters)
+{
+  const auto typedAccept = headers.tryGet<Http::Header::Accept>();
+  if (!typedAccept)
+    return find(headers, acceptHeader).value_or("");
+
+  std::string value;
+  for (const auto& media : typedAccept->media())
+  {
+    if (!value.empty())
+      value += ", ";
+    value += mediaRange(media, parameters);
+  }
+  return value;
+}
+
+}
@@ -0,0 +1,28 @@
+#ifndef REQUEST_HEADERS_H
+#define REQUEST_HEADERS_H
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <pistache/endpoint.h>
+
+// Header values as text, whichever way Pistache stored them.
+namespace request_headers
+{
+
+// Value of the header with this name, looked up among both the headers Pistache parses into
+// types and the raw ones, because which headers are typed and how raw header names are keyed
+// depends on the Pistache version.
+std::optional<std::string> find(const Pistache::Http::Header::Collection& headers,
+                                const std::string& name);
+
+// The Accept header as a list of media ranges with their q-values and the given parameters.
+// Pistache parses Accept into a typed header whose write() produces nothing, so the list is
+// rebuilt from the parsed media types; the raw header is only used when it isn't typed.
+std::string accept(const Pistache::Http::Header::Collection& headers,
+                   const std::vector<std::string>& parameters);
+
+}
+
+#endif // REQUEST_HEADERS_H
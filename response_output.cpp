@@ -0,0 +1,125 @@
+#include "response_output.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <sys/socket.h>
+
+using namespace Pistache;
+
+ResponseOutput::ResponseOutput(Http::ResponseWriter& response, Http::Code code, size_t chunkBytes)
+  : ResponseOutput(response, code, body_codec::Encoding::Identity, {}, chunkBytes)
+{
+}
+
+ResponseOutput::ResponseOutput(Http::ResponseWriter& response,
+                               Http::Code code,
+                               body_codec::Encoding encoding,
+                               const body_codec::CompressionSettings& settings,
+                               size_t chunkBytes)
+  : response_(response),
+    code_(code),
+    chunkBytes_(std::max<size_t>(chunkBytes, 1)),
+    encoding_(encoding),
+    settings_(settings),
+    encodingChosen_(encoding == body_codec::Encoding::Identity)
+{
+  buffer_.reserve(chunkBytes_);
+}
+
+void ResponseOutput::write(std::string_view data)
+{
+  if (!encodingChosen_)
+  {
+    unencodedStart_.append(data.data(), data.size());
+    if (unencodedStart_.size() >= std::max(settings_.minBytes, chunkBytes_))
+      chooseEncoding();
+    return;
+  }
+
+  if (encoder_)
+    encoder_->write(data, [this](std::string_view encoded){ writeEncoded(encoded); });
+  else
+    writeEncoded(data);
+}
+
+void ResponseOutput::flush()
+{
+  if (!encodingChosen_)
+    chooseEncoding();
+  if (encoder_)
+    encoder_->flush([this](std::string_view encoded){ writeEncoded(encoded); });
+
+  if (!buffer_.empty())
+    sendChunk();
+}
+
+void ResponseOutput::finish()
+{
+  if (!encodingChosen_)
+    chooseEncoding();
+  if (encoder_)
+    encoder_->finish([this](std::string_view encoded){ writeEncoded(encoded); });
+
+  if (!stream_)
+  {
+    response_.send(code_, buffer_);
+    return;
+  }
+
+  if (!buffer_.empty())
+    sendChunk();
+  stream_->ends();
+}
+
+void ResponseOutput::abort()
+{
+  // Without the terminating chunk, the client can't take the body for a whole one.
+  try
+  {
+    if (auto peer = response_.peer())
+      ::shutdown(peer->fd(), SHUT_RDWR);
+  }
+  catch (const std::runtime_error&)
+  {
+    // Pistache throws if the peer is gone already, which leaves nothing to close.
+  }
+}
+
+void ResponseOutput::chooseEncoding()
+{
+  encodingChosen_ = true;
+  if (unencodedStart_.size() >= settings_.minBytes)
+  {
+    encoder_ = body_codec::makeEncoder(encoding_, settings_);
+    response_.headers().addRaw(Http::Header::Raw("Content-Encoding",
+                                                 body_codec::encodingName(encoding_)));
+  }
+
+  const std::string unencodedStart = std::move(unencodedStart_);
+  unencodedStart_.clear();
+  write(unencodedStart);
+}
+
+void ResponseOutput::writeEncoded(std::string_view data)
+{
+  while (!data.empty())
+  {
+    const size_t length = std::min(data.size(), chunkBytes_ - buffer_.size());
+    buffer_.append(data.data(), length);
+    data.remove_prefix(length);
+
+    if (buffer_.size() == chunkBytes_)
+      sendChunk();
+  }
+}
+
+void ResponseOutput::sendChunk()
+{
+  if (!stream_)
+    stream_.emplace(response_.stream(code_));
+
+  stream_->write(buffer_.data(), buffer_.size());
+  stream_->flush();
+  buffer_.clear();
+}
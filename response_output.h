@@ -0,0 +1,67 @@
+#ifndef RESPONSE_OUTPUT_H
+#define RESPONSE_OUTPUT_H
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <pistache/endpoint.h>
+
+#include "body_codec.h"
+
+// Response body written piece by piece. A body that fits in one chunk is sent as a plain response
+// with a Content-Length; a larger one switches to chunked transfer encoding as soon as the first
+// chunk is full, so the client receives the beginning while the rest is still being produced.
+// Headers must be set on the writer before the first write().
+class ResponseOutput
+{
+public:
+  static constexpr size_t defaultChunkBytes = 64*1024;
+
+  ResponseOutput(Pistache::Http::ResponseWriter& response,
+                 Pistache::Http::Code code,
+                 size_t chunkBytes = defaultChunkBytes);
+  // Compresses the body with `encoding` (and sets Content-Encoding) unless it turns out to be
+  // smaller than `settings.minBytes`.
+  ResponseOutput(Pistache::Http::ResponseWriter& response,
+                 Pistache::Http::Code code,
+                 body_codec::Encoding encoding,
+                 const body_codec::CompressionSettings& settings,
+                 size_t chunkBytes = defaultChunkBytes);
+  ResponseOutput(const ResponseOutput&) = delete;
+  ResponseOutput& operator=(const ResponseOutput&) = delete;
+
+  void write(std::string_view data);
+  // Sends everything written so far, switching to chunked transfer encoding if the response
+  // hasn't started yet; whether to compress is decided now if it hasn't been.
+  void flush();
+  void finish();
+  // Closes the connection instead of finishing a response that is already streaming, so that the
+  // client sees the body cut short rather than a complete-looking one.
+  void abort();
+
+  // Once streaming, the status line is on the wire and can no longer be replaced by an error.
+  bool isStreaming() const { return stream_.has_value(); }
+
+private:
+  void chooseEncoding();
+  void writeEncoded(std::string_view data);
+  void sendChunk();
+
+  Pistache::Http::ResponseWriter& response_;
+  const Pistache::Http::Code code_;
+  const size_t chunkBytes_;
+
+  // The start of the body is held back until it's clear whether it's worth compressing.
+  const body_codec::Encoding encoding_;
+  const body_codec::CompressionSettings settings_;
+  bool encodingChosen_;
+  std::string unencodedStart_;
+  std::unique_ptr<body_codec::Encoder> encoder_;
+
+  std::string buffer_;
+  std::optional<Pistache::Http::ResponseStream> stream_;
+};
+
+#endif // RESPONSE_OUTPUT_H
@@ -1,11 +1,28 @@
 #include "rest_request_handler.h"
 
-#include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <limits>
+#include <optional>
 #include <sstream>
+#include <string_view>
 
 #include "nlohmann_json/json.hpp"
 
+#include "admission_controller.h"
+#include "content_negotiation.h"
+#include "job_manager.h"
+#include "json_output.h"
 #include "label_processing.h"
+#include "lemma_cache.h"
+#include "lemmatizer_pool.h"
+#include "ndjson_processing.h"
+#include "request_headers.h"
+#include "response_output.h"
+#include "service_state.h"
+#include "wire_format.h"
+#include "work_stealing_pool.h"
 
 using namespace Pistache;
 
@@ -14,41 +31,736 @@ using Json = nlohmann::json;
 namespace
 {
 
-auto getContentType(const Http::Request& request)
+const std::string lemmatizeResource = "/v1/lemmatize";
+const std::string streamResource = "/v1/lemmatize/stream";
+// Where the service answered before it had versioned routes, kept for existing clients.
+const std::string legacyLemmatizeResource = "/";
+const std::string legacyStreamResource = "/lemmatize/stream";
+const std::string healthResource = "/healthz";
+const std::string readinessResource = "/readyz";
+const std::string metricsResource = "/metrics";
+const std::string reloadResource = "/admin/reload";
+const std::string jobsResource = "/v1/jobs";
+const std::string jobResource = "/v1/jobs/:id";
+const std::string jobResultResource = "/v1/jobs/:id/result";
+const std::string prometheusMediaType = "text/plain; version=0.0.4";
+const std::string ndjsonMediaType = "application/x-ndjson";
+const std::string retryAfterSeconds = "1";
+const std::string deltaParameter = "delta";
+const std::string preferHeader = "Prefer";
+const std::string minimalReturnPreference = "return=minimal";
+const std::string compactParameter = "compact";
+const std::string acceptHeader = "Accept";
+const std::string acceptEncodingHeader = "Accept-Encoding";
+const std::string contentEncodingHeader = "Content-Encoding";
+const std::string contentTypeHeader = "Content-Type";
+const std::string deadlineHeader = "X-Request-Deadline-Ms";
+const std::string docIndexKey = "docIndex";
+const std::string skippedKey = "skipped";
+const std::string skippedDocsKey = "skippedDocs";
+const int prettyIndent = 2;
+const size_t maxRequestHeadBytes = 64*1024;
+// Admission cost of a request with a small body; it still costs a parse, a lemmatizer lease and
+// a response.
+const size_t minAdmissionUnits = 1024;
+
+
+std::optional<std::string> findHeader(const Http::Request& request, const std::string& name)
+{
+  return request_headers::find(request.headers(), name);
+}
+
+bool isStreamResource(const std::string& resource)
+{
+  return resource == streamResource || resource == legacyStreamResource;
+}
+
+bool isLemmatizationResource(const std::string& resource)
+{
+  return resource == lemmatizeResource || resource == legacyLemmatizeResource
+      || isStreamResource(resource);
+}
+
+// The media type without parameters, e.g. "application/json" for
+// "application/json; charset=utf-8". Compared as a string because Pistache's MediaType treats
+// all subtypes it doesn't know, such as cbor and x-ndjson, as equal.
+std::string mediaTypeOf(const std::optional<std::string>& contentType)
+{
+  const auto entries = content_negotiation::parseAcceptList(contentType.value_or(""));
+  return entries.empty() ? std::string() : entries.front().value;
+}
+
+std::string requestMediaType(const Http::Request& request)
+{
+  return mediaTypeOf(findHeader(request, contentTypeHeader));
+}
+
+std::optional<wire_format::WireFormat> requestWireFormat(const Http::Request& request)
+{
+  return wire_format::fromMediaType(requestMediaType(request));
+}
+
+std::string acceptedMediaTypes(const std::string& resource)
 {
-  return request.headers().get<Http::Header::ContentType>()->mime();
+  if (isStreamResource(resource))
+    return "\"" + ndjsonMediaType + "\"";
+
+  return "\"" + wire_format::mediaType(wire_format::WireFormat::Json) + "\", \""
+         + wire_format::mediaType(wire_format::WireFormat::Cbor) + "\" or \""
+         + wire_format::mediaType(wire_format::WireFormat::MessagePack) + "\"";
 }
 
+// What the body of a lemmatization request must be, checked both on its head as soon as it
+// arrives and on the complete request.
+std::optional<Rejection> checkLemmatizationRequest(const std::string& resource,
+                                                   const std::string& mediaType,
+                                                   const std::string& contentEncoding)
+{
+  const bool isExpectedType = isStreamResource(resource)
+      ? mediaType == ndjsonMediaType
+      : wire_format::fromMediaType(mediaType).has_value();
+  if (!isExpectedType)
+  {
+    return Rejection{415, "Invalid request content type; " + acceptedMediaTypes(resource)
+                          + " expected.\n"};
+  }
+
+  if (!body_codec::parseEncoding(contentEncoding))
+    return Rejection{415, "Unsupported content encoding \"" + contentEncoding + "\".\n"};
+
+  return std::nullopt;
+}
+
+// Jobs are read a line at a time straight from the spooled upload, so it can't be compressed.
+std::optional<Rejection> checkJobRequest(const std::string& mediaType,
+                                         const std::string& contentEncoding)
+{
+  if (mediaType != ndjsonMediaType)
+  {
+    return Rejection{415, "Invalid request content type; \"" + ndjsonMediaType
+                          + "\" expected.\n"};
+  }
+
+  const auto encoding = body_codec::parseEncoding(contentEncoding);
+  if (encoding != body_codec::Encoding::Identity)
+    return Rejection{415, "Jobs can't have a content encoding.\n"};
+
+  return std::nullopt;
+}
+
+// Other resources are left to the router, which refuses unknown ones without a body anyway.
+std::optional<Rejection> checkRequestHead(const RequestHead& head)
+{
+  if (head.resource == jobsResource && head.method == "POST")
+  {
+    return checkJobRequest(mediaTypeOf(head.header(contentTypeHeader)),
+                           head.header(contentEncodingHeader).value_or(""));
+  }
+  if (!isLemmatizationResource(head.resource))
+    return std::nullopt;
+  if (head.method != "POST")
+    return Rejection{405, "Invalid request method; only POST is accepted.\n"};
+  return checkLemmatizationRequest(head.resource,
+                                   mediaTypeOf(head.header(contentTypeHeader)),
+                                   head.header(contentEncodingHeader).value_or(""));
+}
+
+// One sample in the Prometheus text format.
+void appendMetric(std::ostringstream& output,
+                  const std::string& name,
+                  const std::string& type,
+                  const std::string& help,
+                  double value)
+{
+  output << "# HELP " << name << " " << help << "\n"
+         << "# TYPE " << name << " " << type << "\n"
+         << name << " " << value << "\n";
+}
+
+double toSeconds(std::chrono::microseconds duration)
+{
+  return std::chrono::duration<double>(duration).count();
+}
+
+void logAdmissionStart(AdmissionController::Ticket& admission, const AdmissionController& controller)
+{
+  const auto queueWait = admission.start();
+  const auto statistics = controller.statistics();
+  std::cout << "  Compute Queue Wait: " << queueWait.count() << " us\n";
+  std::cout << "  Admission Queue: " << statistics.units << "/" << statistics.capacity
+            << " bytes, " << statistics.requests << " request(s), "
+            << statistics.waiting << " waiting, " << statistics.rejected << " rejected, "
+            << "max wait " << statistics.maxWait.count() << " us\n";
+}
+
+// Ordered by doc; a doc left unfinished is listed as {"docIndex": ..., "skipped": true}.
+Json makeDeltaJson(const std::vector<label_processing::DocLemmatization>& docLemmatizations,
+                   const std::vector<size_t>& skippedDocIndices)
+{
+  Json delta = Json::array();
+  auto skippedDocIndex = skippedDocIndices.begin();
+  const auto addSkippedDocsBefore = [&](size_t docIndex)
+  {
+    for (; skippedDocIndex != skippedDocIndices.end() && *skippedDocIndex < docIndex; ++skippedDocIndex)
+      delta.push_back({{docIndexKey, *skippedDocIndex}, {skippedKey, true}});
+  };
+
+  for (const auto& docLemmatization : docLemmatizations)
+  {
+    if (docLemmatization.lemmatizedLabels.empty())
+      continue;
+    addSkippedDocsBefore(docLemmatization.docIndex);
+    delta.push_back({{docIndexKey, docLemmatization.docIndex},
+                     {key_names::labelsKey, docLemmatization.lemmatizedLabels}});
+  }
+  addSkippedDocsBefore(std::numeric_limits<size_t>::max());
+  return delta;
+}
+
+// The time after which the rest of a request's work is skipped, from its X-Request-Deadline-Ms
+// header: the milliseconds the client is prepared to wait, counted from now, i.e. once the whole
+// body has been received, so the upload time isn't part of the budget.
+// Throws std::invalid_argument if the header isn't a number of milliseconds.
+std::optional<std::chrono::steady_clock::time_point> readDeadline(const Http::Request& request)
+{
+  const auto value = findHeader(request, deadlineHeader);
+  if (!value)
+    return std::nullopt;
+
+  const bool isNumber = !value->empty() && value->size() <= 12
+      && std::all_of(value->begin(), value->end(), [](unsigned char character)
+         {
+           return std::isdigit(character);
+         });
+  if (!isNumber)
+    throw std::invalid_argument("Invalid " + deadlineHeader + " \"" + *value + "\".");
+
+  return std::chrono::steady_clock::now() + std::chrono::milliseconds(std::stoll(*value));
+}
+
+}
+
+RestRequestHandler::RestRequestHandler(std::shared_ptr<ServiceState> state,
+                                       std::shared_ptr<WorkStealingPool> computePool,
+                                       std::shared_ptr<AdmissionController> admission,
+                                       std::shared_ptr<JobManager> jobs,
+                                       const ServerConfig& config)
+  : state_(std::move(state)),
+    computePool_(std::move(computePool)),
+    admission_(std::move(admission)),
+    jobs_(std::move(jobs)),
+    compression_{config.gzipLevel, config.zstdLevel, config.compressionMinBytes},
+    maxDecodedRequestBytes_(config.maxDecodedRequestBytes),
+    maxRequestBytes_(config.maxRequestBytes),
+    maxJobBytes_(config.maxJobBytes)
+{
+  setUpRoutes();
+}
+
+RestRequestHandler::RestRequestHandler(const RestRequestHandler& other)
+  : RestRequestHandler(other, other)
+{
+}
+
+RestRequestHandler::RestRequestHandler(const RestRequestHandler& other,
+                                       const Http::Handler& connectionHandler)
+  : Http::Handler(connectionHandler),
+    state_(other.state_),
+    computePool_(other.computePool_),
+    admission_(other.admission_),
+    jobs_(other.jobs_),
+    compression_(other.compression_),
+    maxDecodedRequestBytes_(other.maxDecodedRequestBytes_),
+    maxRequestBytes_(other.maxRequestBytes_),
+    maxJobBytes_(other.maxJobBytes_)
+{
+  setUpRoutes();
+}
+
+void RestRequestHandler::setUpRoutes()
+{
+  using namespace Rest;
+  Routes::Post(router_, lemmatizeResource, Routes::bind(&RestRequestHandler::lemmatize, this));
+  Routes::Post(router_, streamResource, Routes::bind(&RestRequestHandler::lemmatizeStream, this));
+  Routes::Post(router_, legacyLemmatizeResource, Routes::bind(&RestRequestHandler::lemmatize, this));
+  Routes::Post(router_, legacyStreamResource,
+               Routes::bind(&RestRequestHandler::lemmatizeStream, this));
+  Routes::Get(router_, healthResource, Routes::bind(&RestRequestHandler::sendHealth, this));
+  Routes::Get(router_, readinessResource, Routes::bind(&RestRequestHandler::sendReadiness, this));
+  Routes::Get(router_, metricsResource, Routes::bind(&RestRequestHandler::sendMetrics, this));
+  Routes::Post(router_, reloadResource, Routes::bind(&RestRequestHandler::requestReload, this));
+
+  if (jobs_)
+  {
+    Routes::Post(router_, jobsResource, Routes::bind(&RestRequestHandler::submitJob, this));
+    Routes::Get(router_, jobResource, Routes::bind(&RestRequestHandler::sendJobProgress, this));
+    Routes::Get(router_, jobResultResource, Routes::bind(&RestRequestHandler::sendJobResult, this));
+    Routes::Delete(router_, jobResource, Routes::bind(&RestRequestHandler::removeJob, this));
+  }
+}
+
+RequestHeadFilter RestRequestHandler::makeHeadFilter() const
+{
+  const bool acceptsJobs = jobs_ != nullptr;
+  const auto maxBodyBytes = [acceptsJobs, maxRequestBytes = maxRequestBytes_,
+                             maxJobBytes = maxJobBytes_](const RequestHead& head)
+  {
+    return acceptsJobs && head.resource == jobsResource ? maxJobBytes : maxRequestBytes;
+  };
+  return RequestHeadFilter(maxRequestHeadBytes, maxBodyBytes, checkRequestHead);
 }
 
 void RestRequestHandler::onRequest(const Http::Request& request, Http::ResponseWriter response)
+{
+  // The router takes the writer even when it finds no route, so these answers go to a copy.
+  auto fallbackResponse = response.clone();
+  switch (router_.route(request, std::move(response)))
+  {
+    case Rest::Route::Status::Match:
+      break;
+    case Rest::Route::Status::NotAllowed:
+      fallbackResponse.send(Http::Code::Method_Not_Allowed,
+                            "Method not allowed for " + request.resource() + ".\n");
+      break;
+    case Rest::Route::Status::NotFound:
+      fallbackResponse.send(Http::Code::Not_Found, "Unknown resource " + request.resource() + ".\n");
+      break;
+  }
+}
+
+void RestRequestHandler::lemmatize(const Rest::Request& request, Http::ResponseWriter response)
+{
+  acceptLemmatization(request, std::move(response), false);
+}
+
+void RestRequestHandler::lemmatizeStream(const Rest::Request& request,
+                                         Http::ResponseWriter response)
+{
+  acceptLemmatization(request, std::move(response), true);
+}
+
+void RestRequestHandler::acceptLemmatization(const Http::Request& request,
+                                             Http::ResponseWriter response,
+                                             bool isStream) const
+{
+  std::cout << composeRequestDescription(request);
+
+  const auto contentEncoding = findHeader(request, contentEncodingHeader).value_or("");
+  if (const auto rejection = checkLemmatizationRequest(request.resource(),
+                                                       requestMediaType(request),
+                                                       contentEncoding))
+  {
+    std::cout << "> Request Rejected: " << rejection->message;
+    response.send(static_cast<Http::Code>(rejection->statusCode), rejection->message);
+    return;
+  }
+  const auto requestEncoding = body_codec::parseEncoding(contentEncoding);
+
+  // The head filter holds bodies to this limit already; checked again because Pistache's own
+  // limit is raised to that of jobs when they are enabled.
+  if (request.body().size() > maxRequestBytes_)
+  {
+    std::cout << "> Request Rejected, body too large\n";
+    response.send(Http::Code::Payload_Too_Large, "The request body exceeds "
+                  + std::to_string(maxRequestBytes_) + " bytes.\n");
+    return;
+  }
+
+  std::shared_ptr<LemmaCache> lemmaCache;
+  auto lemmatizerPool = state_->lemmatizerPool(lemmaCache);
+  if (!state_->isReady() || !lemmatizerPool)
+  {
+    std::cout << "> Request Rejected, lemmatizer not ready\n";
+    sendUnavailableResponse(response);
+    return;
+  }
+
+  std::optional<Deadline> deadline;
+  try
+  {
+    deadline = readDeadline(request);
+  }
+  catch (const std::invalid_argument& exception)
+  {
+    std::cout << "> Request Rejected: " << exception.what() << "\n";
+    response.send(Http::Code::Bad_Request, std::string(exception.what()) + "\n");
+    return;
+  }
+
+  // Shed here, before the body is copied and queued, so that the requests already accepted keep
+  // their latency during a burst.
+  auto admission = admission_->tryAdmit(std::max(request.body().size(), minAdmissionUnits));
+  if (!admission)
+  {
+    std::cout << "> Request Rejected, admission queue full\n";
+    sendOverloadedResponse(response);
+    return;
+  }
+
+  if (isStream)
+  {
+    submitStreamLemmatization(request, *requestEncoding, std::move(response),
+                              std::move(lemmatizerPool), std::move(lemmaCache),
+                              std::move(admission), deadline);
+  }
+  else
+  {
+    submitLemmatization(request, *requestEncoding, *requestWireFormat(request), std::move(response),
+                        std::move(lemmatizerPool), std::move(lemmaCache),
+                        std::move(admission), deadline);
+  }
+}
+
+void RestRequestHandler::submitLemmatization(const Http::Request& request,
+                                             body_codec::Encoding requestEncoding,
+                                             wire_format::WireFormat requestFormat,
+                                             Http::ResponseWriter response,
+                                             std::shared_ptr<LemmatizerPool> lemmatizerPool,
+                                             std::shared_ptr<LemmaCache> lemmaCache,
+                                             std::shared_ptr<AdmissionController::Ticket> admission,
+                                             std::optional<Deadline> deadline) const
+{
+  // Parsing, lemmatization and serialisation run on the compute pool, so that a large document
+  // doesn't hold up this I/O thread and every other connection it serves. The request is only
+  // valid for the duration of onRequest, hence the copy of the body; the writer is completed
+  // from the worker. The admission ticket goes with the task and is given back when it's done.
+  const auto options = readResponseOptions(request);
+  if (options.delta)
+    response.headers().addRaw(Http::Header::Raw("Preference-Applied", minimalReturnPreference));
+  response.headers().addRaw(Http::Header::Raw("Vary", acceptHeader + ", " + acceptEncodingHeader));
+
+  std::weak_ptr<Tcp::Peer> peer = response.peer();
+  auto sharedResponse = std::make_shared<Http::ResponseWriter>(std::move(response));
+  computePool_->submit([requestBody = request.body(),
+                        requestEncoding,
+                        requestFormat,
+                        maxDecodedBytes = maxDecodedRequestBytes_,
+                        sharedResponse,
+                        lemmatizerPool = std::move(lemmatizerPool),
+                        lemmaCache = std::move(lemmaCache),
+                        options,
+                        admission = std::move(admission),
+                        controller = admission_,
+                        deadline,
+                        peer]() mutable
+  {
+    logAdmissionStart(*admission, *controller);
+
+    if (!decodeRequestBody(requestBody, requestEncoding, maxDecodedBytes, *sharedResponse))
+      return;
+
+    // A skipped doc is listed for either reason; the response is dropped below if the client left.
+    const auto shouldStop = [checkStop = makeStopCheck(deadline, peer)]
+    {
+      return checkStop() != StopReason::None;
+    };
+    Json lemmatizedJson;
+    try
+    {
+      lemmatizedJson = lemmatizeRequestJson(requestBody, requestFormat, *lemmatizerPool,
+                                            lemmaCache.get(), options, shouldStop);
+    }
+    catch (const std::exception& exception)
+    {
+      std::cout << "> Failed to process input JSON: " << exception.what() << "\n";
+      sharedResponse->send(Http::Code::Unprocessable_Entity, exception.what());
+      return;
+    }
+
+    if (peer.expired())
+    {
+      std::cout << "> Client disconnected, response dropped\n";
+      return;
+    }
+
+    std::cout << "> Input JSON processed successfully, sending response...\n";
+
+    sendLemmatizedJson(lemmatizedJson, options, *sharedResponse);
+
+    std::cout << "> Done\n";
+  });
+}
+
+void RestRequestHandler::submitStreamLemmatization(const Http::Request& request,
+                                                   body_codec::Encoding requestEncoding,
+                                                   Http::ResponseWriter response,
+                                                   std::shared_ptr<LemmatizerPool> lemmatizerPool,
+                                                   std::shared_ptr<LemmaCache> lemmaCache,
+                                                   std::shared_ptr<AdmissionController::Ticket> admission,
+                                                   std::optional<Deadline> deadline) const
+{
+  // Every line is compact already, so of the response options only the encoding applies.
+  const auto options = readResponseOptions(request);
+  response.headers().addRaw(Http::Header::Raw("Vary", acceptEncodingHeader));
+
+  std::weak_ptr<Tcp::Peer> peer = response.peer();
+  auto sharedResponse = std::make_shared<Http::ResponseWriter>(std::move(response));
+  computePool_->submit([requestBody = request.body(),
+                        requestEncoding,
+                        maxDecodedBytes = maxDecodedRequestBytes_,
+                        sharedResponse,
+                        lemmatizerPool = std::move(lemmatizerPool),
+                        lemmaCache = std::move(lemmaCache),
+                        options,
+                        admission = std::move(admission),
+                        controller = admission_,
+                        deadline,
+                        peer]() mutable
+  {
+    logAdmissionStart(*admission, *controller);
+
+    if (!decodeRequestBody(requestBody, requestEncoding, maxDecodedBytes, *sharedResponse))
+      return;
+
+    const auto summary = lemmatizeRequestStream(requestBody, *lemmatizerPool,
+                                                lemmaCache.get(),
+                                                makeStopCheck(deadline, peer),
+                                                options, *sharedResponse);
+    std::cout << "> Streamed " << summary.docs << " doc(s), "
+              << summary.failedLines << " failed line(s)";
+    if (summary.stopReason == StopReason::DeadlineExceeded)
+      std::cout << ", deadline exceeded";
+    else if (summary.stopReason == StopReason::ClientDisconnected)
+      std::cout << ", client disconnected";
+    std::cout << "\n";
+  });
+}
+
+void RestRequestHandler::sendHealth(const Rest::Request&, Http::ResponseWriter response)
+{
+  response.send(Http::Code::Ok, "ok\n");
+}
+
+void RestRequestHandler::sendReadiness(const Rest::Request&, Http::ResponseWriter response)
+{
+  const std::string status = ServiceState::statusName(state_->status()) + "\n";
+  if (state_->isReady())
+  {
+    response.send(Http::Code::Ok, status);
+    return;
+  }
+
+  response.headers().addRaw(Http::Header::Raw("Retry-After", retryAfterSeconds));
+  response.send(Http::Code::Service_Unavailable, status);
+}
+
+void RestRequestHandler::sendMetrics(const Rest::Request&, Http::ResponseWriter response)
+{
+  std::ostringstream metrics;
+  metrics.precision(15);
+  appendMetric(metrics, "polem_ready", "gauge", "Whether lemmatization requests are served.",
+               state_->isReady() ? 1 : 0);
+
+  const auto admission = admission_->statistics();
+  appendMetric(metrics, "polem_admission_capacity_bytes", "gauge",
+               "Request bytes admitted for lemmatization at most.", admission.capacity);
+  appendMetric(metrics, "polem_admission_queued_bytes", "gauge",
+               "Request bytes admitted and not yet answered.", admission.units);
+  appendMetric(metrics, "polem_admission_requests", "gauge",
+               "Requests admitted and not yet answered.", admission.requests);
+  appendMetric(metrics, "polem_admission_waiting_requests", "gauge",
+               "Requests admitted and not yet started.", admission.waiting);
+  appendMetric(metrics, "polem_admission_admitted_total", "counter",
+               "Requests admitted.", admission.admitted);
+  appendMetric(metrics, "polem_admission_rejected_total", "counter",
+               "Requests refused with 503 because the admission queue was full.",
+               admission.rejected);
+  appendMetric(metrics, "polem_admission_wait_seconds_total", "counter",
+               "Time admitted requests waited to be started.", toSeconds(admission.totalWait));
+  appendMetric(metrics, "polem_admission_max_wait_seconds", "gauge",
+               "Longest time an admitted request waited to be started.",
+               toSeconds(admission.maxWait));
+
+  const auto compute = computePool_->statistics();
+  appendMetric(metrics, "polem_compute_threads", "gauge", "Compute threads.",
+               compute.threadCount);
+  appendMetric(metrics, "polem_compute_queued_tasks", "gauge", "Compute tasks queued.",
+               compute.queued);
+  appendMetric(metrics, "polem_compute_running_tasks", "gauge", "Compute tasks running.",
+               compute.running);
+  appendMetric(metrics, "polem_compute_completed_total", "counter", "Compute tasks completed.",
+               compute.completed);
+  appendMetric(metrics, "polem_compute_stolen_total", "counter",
+               "Compute tasks taken from another thread's queue.", compute.stolen);
+
+  if (const auto lemmatizerPool = state_->lemmatizerPool())
+  {
+    const auto lemmatizers = lemmatizerPool->statistics();
+    appendMetric(metrics, "polem_lemmatizers", "gauge", "Lemmatizers assembled.",
+                 lemmatizers.size);
+    appendMetric(metrics, "polem_lemmatizers_in_use", "gauge", "Lemmatizers in use.",
+                 lemmatizers.inUse);
+    appendMetric(metrics, "polem_lemmatizer_waiting_requests", "gauge",
+                 "Requests waiting for a lemmatizer.", lemmatizers.waiting);
+    appendMetric(metrics, "polem_lemmatizer_wait_seconds_total", "counter",
+                 "Time spent waiting for a lemmatizer.", toSeconds(lemmatizers.totalWaitTime));
+  }
+
+  if (const auto lemmaCache = state_->lemmaCache())
+  {
+    const auto cache = lemmaCache->statistics();
+    appendMetric(metrics, "polem_lemma_cache_hits_total", "counter", "Lemma cache hits.",
+                 cache.hits);
+    appendMetric(metrics, "polem_lemma_cache_misses_total", "counter", "Lemma cache misses.",
+                 cache.misses);
+    appendMetric(metrics, "polem_lemma_cache_evictions_total", "counter",
+                 "Lemma cache evictions.", cache.evictions);
+    appendMetric(metrics, "polem_lemma_cache_bytes", "gauge", "Lemma cache size.", cache.bytes);
+  }
+
+  response.send(Http::Code::Ok, metrics.str(), Http::Mime::MediaType::fromString(prometheusMediaType));
+}
+
+void RestRequestHandler::requestReload(const Rest::Request& request, Http::ResponseWriter response)
+{
+  std::cout << "> Lemmatizer reload requested by " << request.address().host() << "\n";
+  if (!state_->requestReload())
+  {
+    response.send(Http::Code::Conflict, "A reload is already in progress.\n");
+    return;
+  }
+
+  response.send(Http::Code::Accepted, "Reload started.\n");
+}
+
+void RestRequestHandler::submitJob(const Rest::Request& request, Http::ResponseWriter response)
 {
   std::cout << composeRequestDescription(request);
 
-  if (!isRequestValid(request))
+  const auto contentEncoding = findHeader(request, contentEncodingHeader).value_or("");
+  if (const auto rejection = checkJobRequest(requestMediaType(request), contentEncoding))
+  {
+    std::cout << "> Job Rejected: " << rejection->message;
+    response.send(static_cast<Http::Code>(rejection->statusCode), rejection->message);
+    return;
+  }
+  if (request.body().size() > maxJobBytes_)
   {
-    std::cout << "> Request Rejected\n";
-    sendErrorResponse(request, response);
+    std::cout << "> Job Rejected, body too large\n";
+    response.send(Http::Code::Payload_Too_Large, "The job input exceeds "
+                  + std::to_string(maxJobBytes_) + " bytes.\n");
     return;
   }
+  // Jobs would fail at once otherwise; they may still fail if a reload fails before they run.
+  if (!state_->isReady())
+  {
+    std::cout << "> Job Rejected, lemmatizer not ready\n";
+    sendUnavailableResponse(response);
+    return;
+  }
+
+  // The input is spooled to disk on the compute pool, so that writing up to maxJobBytes doesn't
+  // hold up this I/O thread; like a lemmatization request, it takes a copy of the body.
+  auto sharedResponse = std::make_shared<Http::ResponseWriter>(std::move(response));
+  computePool_->submit([input = request.body(), jobs = jobs_, sharedResponse]
+  {
+    std::string id;
+    try
+    {
+      id = jobs->submit(input);
+    }
+    catch (const std::exception& exception)
+    {
+      std::cout << "> Job Rejected: " << exception.what() << "\n";
+      sharedResponse->send(Http::Code::Internal_Server_Error,
+                           "The job input couldn't be stored.\n");
+      return;
+    }
+
+    std::cout << "> Job " << id << " queued\n";
+    const Json job = {{"id", id},
+                      {"status", JobManager::statusName(JobManager::Status::Queued)}};
+    sharedResponse->headers().addRaw(Http::Header::Raw("Location", jobsResource + "/" + id));
+    sharedResponse->send(Http::Code::Accepted, job.dump() + "\n",
+                         Http::Mime::MediaType::fromString(
+                           wire_format::mediaType(wire_format::WireFormat::Json)));
+  });
+}
+
+void RestRequestHandler::sendJobProgress(const Rest::Request& request,
+                                         Http::ResponseWriter response)
+{
+  const auto id = request.param(":id").as<std::string>();
+  const auto progress = jobs_->progress(id);
+  if (!progress)
+  {
+    response.send(Http::Code::Not_Found, "Unknown job " + id + ".\n");
+    return;
+  }
+
+  Json job = {{"id", id},
+              {"status", JobManager::statusName(progress->status)},
+              {"inputBytes", progress->inputBytes},
+              {"processedBytes", progress->processedBytes},
+              {"docs", progress->docs},
+              {"failedLines", progress->failedLines}};
+  if (progress->status == JobManager::Status::Done)
+    job["result"] = jobsResource + "/" + id + "/result";
+  if (progress->status == JobManager::Status::Failed)
+    job["error"] = progress->error;
+
+  response.send(Http::Code::Ok, job.dump() + "\n",
+                Http::Mime::MediaType::fromString(
+                  wire_format::mediaType(wire_format::WireFormat::Json)));
+}
 
-  std::string lemmatizedJson;
+void RestRequestHandler::sendJobResult(const Rest::Request& request, Http::ResponseWriter response)
+{
+  const auto id = request.param(":id").as<std::string>();
+  const auto progress = jobs_->progress(id);
+  if (!progress)
+  {
+    response.send(Http::Code::Not_Found, "Unknown job " + id + ".\n");
+    return;
+  }
+
+  const auto resultPath = jobs_->resultPath(id);
+  if (!resultPath)
+  {
+    response.send(Http::Code::Conflict,
+                  "Job " + id + " is " + JobManager::statusName(progress->status) + ".\n");
+    return;
+  }
+
+  // Sent from the file with sendfile(), never read into memory.
   try
   {
-    lemmatizedJson = lemmatizeRequestJson(request);
+    Http::serveFile(response, resultPath->string(),
+                    Http::Mime::MediaType::fromString(ndjsonMediaType));
   }
-  catch (const std::runtime_error& exception)
+  catch (const std::exception& exception)
   {
-    std::cout << "> Failed to process input JSON: " << exception.what() << "\n";
-    response.send(Http::Code::Unprocessable_Entity, exception.what());
+    // Removed since it was looked up.
+    std::cout << "> Job " << id << " result not sent: " << exception.what() << "\n";
+    response.send(Http::Code::Not_Found, "Unknown job " + id + ".\n");
   }
+}
 
-  std::cout << "> Input JSON processed successfully, sending response...\n";
+void RestRequestHandler::removeJob(const Rest::Request& request, Http::ResponseWriter response)
+{
+  const auto id = request.param(":id").as<std::string>();
+  if (!jobs_->remove(id))
+  {
+    response.send(Http::Code::Not_Found, "Unknown job " + id + ".\n");
+    return;
+  }
 
-  response.setMime(Http::Mime::MediaType::fromString("application/json"));
-  response.send(Http::Code::Ok, lemmatizedJson);
+  std::cout << "> Job " << id << " removed\n";
+  response.send(Http::Code::No_Content);
+}
 
-  std::cout << "> Done\n";
+void RestRequestHandler::sendUnavailableResponse(Http::ResponseWriter& response) const
+{
+  response.headers().addRaw(Http::Header::Raw("Retry-After", retryAfterSeconds));
+  response.send(Http::Code::Service_Unavailable,
+                "The lemmatizer is " + ServiceState::statusName(state_->status()) + ".\n");
+}
+
+void RestRequestHandler::sendOverloadedResponse(Http::ResponseWriter& response) const
+{
+  response.headers().addRaw(Http::Header::Raw("Retry-After", retryAfterSeconds));
+  response.send(Http::Code::Service_Unavailable,
+                "The server is overloaded; retry later.\n");
 }
 
 std::string RestRequestHandler::composeRequestDescription(const Http::Request& request) const
@@ -59,36 +771,222 @@ std::string RestRequestHandler::composeRequestDescription(const Http::Request& r
   description << "  Port: " << request.address().port() << "\n";
   description << "  Method: " << request.method() << "\n";
   description << "  Resource: " << request.resource() << "\n";
-  description << "  Content Type: " << getContentType(request).raw() << "\n";
+  description << "  Content Type: " << findHeader(request, contentTypeHeader).value_or("") << "\n";
+  description << "  Content Encoding: "
+              << findHeader(request, contentEncodingHeader).value_or("identity") << "\n";
   description << "  Body Length: " << request.body().size() << "\n";
 
   return description.str();
 }
 
-bool RestRequestHandler::isRequestValid(const Http::Request& request) const
+RestRequestHandler::ResponseOptions
+RestRequestHandler::readResponseOptions(const Http::Request& request) const
 {
-  auto requestContentType = getContentType(request);
-  const bool isPost = request.method() == Http::Method::Post;
-  const bool isJson = requestContentType == Http::Mime::MediaType::fromString("application/json");
-  return isPost && isJson;
+  ResponseOptions options;
+
+  // Either ?delta=true or the standard "Prefer: return=minimal" selects the delta response.
+  options.delta = content_negotiation::isFlagEnabled(request.query().get(deltaParameter));
+  if (const auto prefer = findHeader(request, preferHeader))
+    options.delta = options.delta || prefer->find(minimalReturnPreference) != std::string::npos;
+
+  // Pretty printing stays the default for people reading the output; clients ask for compact
+  // output with ?compact=true or "Accept: application/json; compact=true".
+  const auto accept = request_headers::accept(request.headers(), {compactParameter});
+  const bool compact =
+      content_negotiation::isFlagEnabled(request.query().get(compactParameter))
+      || content_negotiation::isFlagEnabled(content_negotiation::findMediaTypeParameter(
+           accept, wire_format::mediaType(wire_format::WireFormat::Json), compactParameter));
+  options.indent = compact ? -1 : prettyIndent;
+  options.format = wire_format::selectResponseFormat(accept);
+
+  options.encoding = body_codec::selectResponseEncoding(
+        findHeader(request, acceptEncodingHeader).value_or(""));
+  options.compression = compression_;
+
+  return options;
+}
+
+RestRequestHandler::StopCheck
+RestRequestHandler::makeStopCheck(std::optional<Deadline> deadline, std::weak_ptr<Tcp::Peer> peer)
+{
+  // Work stops at the deadline, and as soon as the client disconnects, since nobody will read the
+  // result then.
+  return [deadline, peer = std::move(peer)]()
+  {
+    if (peer.expired())
+      return StopReason::ClientDisconnected;
+    if (deadline && std::chrono::steady_clock::now() >= *deadline)
+      return StopReason::DeadlineExceeded;
+    return StopReason::None;
+  };
+}
+
+bool RestRequestHandler::decodeRequestBody(std::string& requestBody,
+                                           body_codec::Encoding encoding,
+                                           size_t maxDecodedBytes,
+                                           Http::ResponseWriter& response)
+{
+  if (encoding == body_codec::Encoding::Identity)
+    return true;
+
+  try
+  {
+    const auto encodedBytes = requestBody.size();
+    requestBody = body_codec::decode(encoding, requestBody, maxDecodedBytes);
+    std::cout << "  Decoded Body Length: " << requestBody.size() << " (from " << encodedBytes
+              << " " << body_codec::encodingName(encoding) << " bytes)\n";
+    return true;
+  }
+  catch (const body_codec::DecodedBodyTooLarge& exception)
+  {
+    std::cout << "> Request Rejected: " << exception.what() << "\n";
+    response.send(Http::Code::Payload_Too_Large, std::string(exception.what()) + "\n");
+  }
+  catch (const std::exception& exception)
+  {
+    std::cout << "> Request Rejected: " << exception.what() << "\n";
+    response.send(Http::Code::Bad_Request, std::string(exception.what()) + "\n");
+  }
+  return false;
 }
 
-void RestRequestHandler::sendErrorResponse(const Http::Request& request,
-                                           Http::ResponseWriter& response) const
+Json RestRequestHandler::lemmatizeRequestJson(const std::string& requestBody,
+                                              wire_format::WireFormat requestFormat,
+                                              LemmatizerPool& lemmatizerPool,
+                                              LemmaCache* lemmaCache,
+                                              const ResponseOptions& options,
+                                              const label_processing::StopCondition& shouldStop)
 {
-  if (request.method() != Http::Method::Post)
-    response.send(Http::Code::Bad_Request, "Invalid request method; only POST is accepted.\n");
+  Json json = wire_format::parse(requestBody, requestFormat);
+  std::vector<size_t> skippedDocIndices;
+  {
+    auto lemmatizer = lemmatizerPool.acquire();
+    if (options.delta)
+    {
+      json = makeDeltaJson(label_processing::lemmatizeNerLabelsInJson(json, *lemmatizer, lemmaCache,
+                                                                      shouldStop,
+                                                                      &skippedDocIndices),
+                           skippedDocIndices);
+    }
+    else
+    {
+      label_processing::findAndLemmatizeNerLabelsInJson(json, *lemmatizer, lemmaCache, shouldStop,
+                                                        &skippedDocIndices);
+      // Skipped docs are returned as they came, and listed, so that the client can retry them.
+      if (!skippedDocIndices.empty())
+        json[skippedDocsKey] = skippedDocIndices;
+    }
 
-  if (getContentType(request) != Http::Mime::MediaType::fromString("application/json"))
-    response.send(Http::Code::Unsupported_Media_Type,
-                  "Invalid request content type; \"application/json\" expected.\n");
+    const auto poolStatistics = lemmatizerPool.statistics();
+    std::cout << "  Lemmatizer Wait: " << lemmatizer.waitTime().count() << " us\n";
+    std::cout << "  Lemmatizers In Use: " << poolStatistics.inUse << "/" << poolStatistics.size
+              << " (capacity " << poolStatistics.capacity << ", "
+              << poolStatistics.waiting << " waiting)\n";
+  }
+
+  if (!skippedDocIndices.empty())
+    std::cout << "  Skipped Docs: " << skippedDocIndices.size() << "\n";
+
+  if (lemmaCache)
+  {
+    const auto cacheStatistics = lemmaCache->statistics();
+    std::cout << "  Lemma Cache: " << cacheStatistics.hits << " hits, "
+              << cacheStatistics.misses << " misses, "
+              << cacheStatistics.evictions << " evictions, "
+              << cacheStatistics.bytes << "/" << cacheStatistics.byteBudget << " bytes\n";
+  }
+
+  return json;
 }
 
-std::string RestRequestHandler::lemmatizeRequestJson(const Http::Request& request) const
+void RestRequestHandler::sendLemmatizedJson(const Json& json,
+                                            const ResponseOptions& options,
+                                            Http::ResponseWriter& response)
 {
-  Json json = Json::parse(request.body());
-  label_processing::findAndLemmatizeNerLabelsInJson(json);
-  std::stringstream prettyOutputJson;
-  prettyOutputJson << std::setw(2) << json << "\n";
-  return prettyOutputJson.str();
+  // Serialised and sent doc by doc rather than built as one string first, which used to cost
+  // several times the response size at the peak.
+  response.setMime(Http::Mime::MediaType::fromString(wire_format::mediaType(options.format)));
+  ResponseOutput output(response, Http::Code::Ok, options.encoding, options.compression);
+  const auto sink = [&output](std::string_view part){ output.write(part); };
+  try
+  {
+    if (options.format == wire_format::WireFormat::Json)
+    {
+      json_output::serializeByDoc(json, options.indent, sink);
+      output.write("\n");
+    }
+    else
+    {
+      json_output::serializeBinaryByDoc(json, options.format, sink);
+    }
+  }
+  catch (const std::exception& exception)
+  {
+    std::cout << "> Failed to serialise output JSON: " << exception.what() << "\n";
+    // Past the status line, an error can only be told by the response ending prematurely.
+    if (output.isStreaming())
+      output.abort();
+    else
+      response.send(Http::Code::Internal_Server_Error, exception.what());
+    return;
+  }
+  output.finish();
+}
+
+RestRequestHandler::StreamSummary
+RestRequestHandler::lemmatizeRequestStream(const std::string& requestBody,
+                                           LemmatizerPool& lemmatizerPool,
+                                           LemmaCache* lemmaCache,
+                                           const StopCheck& checkStop,
+                                           const ResponseOptions& options,
+                                           Http::ResponseWriter& response)
+{
+  // Every line holds one doc and is answered by one line, in order. A line that can't be
+  // processed is answered with an error object instead, since the status has been sent by then.
+  // Every answer is flushed, so a compressed stream is compressed from the first line on rather
+  // than only past the usual minimum size. The input is the whole body, buffered by Pistache and
+  // copied for this task: the output is streamed, the input isn't.
+  response.setMime(Http::Mime::MediaType::fromString(ndjsonMediaType));
+  auto compression = options.compression;
+  compression.minBytes = 0;
+  ResponseOutput output(response, Http::Code::Ok, options.encoding, compression);
+
+  StreamSummary summary;
+  std::string outputLine;
+  const std::string_view body(requestBody);
+  size_t lineNumber = 0;
+  for (size_t lineStart = 0; lineStart < body.size();)
+  {
+    const size_t lineEnd = std::min(body.find('\n', lineStart), body.size());
+    const auto line = body.substr(lineStart, lineEnd - lineStart);
+    lineStart = lineEnd + 1;
+    ++lineNumber;
+
+    if (ndjson_processing::isBlank(line))
+      continue;
+
+    // The deadline ends the stream with an error naming the first line left out; the lines
+    // before it have all been answered. A disconnected client isn't written to at all.
+    summary.stopReason = checkStop();
+    if (summary.stopReason == StopReason::ClientDisconnected)
+      return summary;
+    if (summary.stopReason == StopReason::DeadlineExceeded)
+    {
+      const Json error = {{"error", "Deadline exceeded"}, {"line", lineNumber}, {skippedKey, true}};
+      output.write(error.dump() + "\n");
+      break;
+    }
+
+    if (ndjson_processing::lemmatizeLine(line, lineNumber, lemmatizerPool, lemmaCache, outputLine))
+      ++summary.docs;
+    else
+      ++summary.failedLines;
+
+    outputLine += '\n';
+    output.write(outputLine);
+    output.flush();
+  }
+
+  output.finish();
+  return summary;
 }
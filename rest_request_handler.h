@@ -1,25 +1,164 @@
 #ifndef REST_REQUEST_HANDLER_H
 #define REST_REQUEST_HANDLER_H
 
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
 
 #include <pistache/endpoint.h>
+#include <pistache/router.h>
 
+#include "nlohmann_json/json.hpp"
 
+#include "admission_controller.h"
+#include "body_codec.h"
+#include "label_processing.h"
+#include "request_head_filter.h"
+#include "server_config.h"
+#include "wire_format.h"
+
+class JobManager;
+class LemmaCache;
+class LemmatizerPool;
+class ServiceState;
+class WorkStealingPool;
+
+// Every request is judged by its head first (by the HeadFilteringHandler in front of this one),
+// then routed: lemmatization under /v1/lemmatize, jobs under /v1/jobs when they are enabled, and
+// the probes, /metrics and the admin operations on routes of their own that skip the request
+// logging and validation.
 class RestRequestHandler : public Pistache::Http::Handler
 {
 public:
   HTTP_PROTOTYPE(RestRequestHandler)
 
+  RestRequestHandler(std::shared_ptr<ServiceState> state,
+                     std::shared_ptr<WorkStealingPool> computePool,
+                     std::shared_ptr<AdmissionController> admission,
+                     // Null if jobs are disabled.
+                     std::shared_ptr<JobManager> jobs,
+                     const ServerConfig& config);
+  // Every I/O thread gets a copy, whose routes have to be bound to the copy.
+  RestRequestHandler(const RestRequestHandler& other);
+  // A copy that takes its Pistache settings and transport from `connectionHandler`, the handler
+  // Pistache delivers the connections to, so that its responses are written through it.
+  RestRequestHandler(const RestRequestHandler& other,
+                     const Pistache::Http::Handler& connectionHandler);
+  RestRequestHandler& operator=(const RestRequestHandler&) = delete;
+
   void onRequest(const Pistache::Http::Request& request,
                  Pistache::Http::ResponseWriter response) override;
 
+  // The filter for the requests of a new connection.
+  RequestHeadFilter makeHeadFilter() const;
+
 private:
+  using Deadline = std::chrono::steady_clock::time_point;
+
+  // Why a request's work ends early, if it does.
+  enum class StopReason
+  {
+    None,
+    DeadlineExceeded,
+    ClientDisconnected
+  };
+  using StopCheck = std::function<StopReason()>;
+
+  // How the lemmatized result is returned, as negotiated by the request.
+  struct ResponseOptions
+  {
+    // Only the added Polem labels, as [{"docIndex": ..., "labels": [...]}], instead of the whole
+    // input with the labels merged in.
+    bool delta = false;
+    // Pretty-printed with this indentation, or compact if negative.
+    int indent = 2;
+    wire_format::WireFormat format = wire_format::WireFormat::Json;
+    body_codec::Encoding encoding = body_codec::Encoding::Identity;
+    body_codec::CompressionSettings compression;
+  };
+
+  void setUpRoutes();
+
+  // Routes
+  void lemmatize(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+  void lemmatizeStream(const Pistache::Rest::Request& request,
+                       Pistache::Http::ResponseWriter response);
+  void sendHealth(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+  void sendReadiness(const Pistache::Rest::Request& request,
+                     Pistache::Http::ResponseWriter response);
+  void sendMetrics(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+  void requestReload(const Pistache::Rest::Request& request,
+                     Pistache::Http::ResponseWriter response);
+  void submitJob(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+  void sendJobProgress(const Pistache::Rest::Request& request,
+                       Pistache::Http::ResponseWriter response);
+  void sendJobResult(const Pistache::Rest::Request& request,
+                     Pistache::Http::ResponseWriter response);
+  void removeJob(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+
+  void acceptLemmatization(const Pistache::Http::Request& request,
+                           Pistache::Http::ResponseWriter response,
+                           bool isStream) const;
+  void sendUnavailableResponse(Pistache::Http::ResponseWriter& response) const;
+  void sendOverloadedResponse(Pistache::Http::ResponseWriter& response) const;
   std::string composeRequestDescription(const Pistache::Http::Request& request) const;
-  bool isRequestValid(const Pistache::Http::Request& request) const;
-  void sendErrorResponse(const Pistache::Http::Request& request,
-                         Pistache::Http::ResponseWriter& response) const;
-  std::string lemmatizeRequestJson(const Pistache::Http::Request& request) const;
+  void submitLemmatization(const Pistache::Http::Request& request,
+                           body_codec::Encoding requestEncoding,
+                           wire_format::WireFormat requestFormat,
+                           Pistache::Http::ResponseWriter response,
+                           std::shared_ptr<LemmatizerPool> lemmatizerPool,
+                           std::shared_ptr<LemmaCache> lemmaCache,
+                           std::shared_ptr<AdmissionController::Ticket> admission,
+                           std::optional<Deadline> deadline) const;
+  void submitStreamLemmatization(const Pistache::Http::Request& request,
+                                 body_codec::Encoding requestEncoding,
+                                 Pistache::Http::ResponseWriter response,
+                                 std::shared_ptr<LemmatizerPool> lemmatizerPool,
+                                 std::shared_ptr<LemmaCache> lemmaCache,
+                                 std::shared_ptr<AdmissionController::Ticket> admission,
+                                 std::optional<Deadline> deadline) const;
+  ResponseOptions readResponseOptions(const Pistache::Http::Request& request) const;
+  static StopCheck makeStopCheck(std::optional<Deadline> deadline,
+                                 std::weak_ptr<Pistache::Tcp::Peer> peer);
+  static bool decodeRequestBody(std::string& requestBody,
+                                body_codec::Encoding encoding,
+                                size_t maxDecodedBytes,
+                                Pistache::Http::ResponseWriter& response);
+  static nlohmann::json lemmatizeRequestJson(const std::string& requestBody,
+                                             wire_format::WireFormat requestFormat,
+                                             LemmatizerPool& lemmatizerPool,
+                                             LemmaCache* lemmaCache,
+                                             const ResponseOptions& options,
+                                             const label_processing::StopCondition& shouldStop);
+  static void sendLemmatizedJson(const nlohmann::json& json,
+                                 const ResponseOptions& options,
+                                 Pistache::Http::ResponseWriter& response);
+
+  struct StreamSummary
+  {
+    size_t docs = 0;
+    size_t failedLines = 0;
+    StopReason stopReason = StopReason::None;
+  };
+  static StreamSummary lemmatizeRequestStream(const std::string& requestBody,
+                                              LemmatizerPool& lemmatizerPool,
+                                              LemmaCache* lemmaCache,
+                                              const StopCheck& checkStop,
+                                              const ResponseOptions& options,
+                                              Pistache::Http::ResponseWriter& response);
+
+  std::shared_ptr<ServiceState> state_;
+  std::shared_ptr<WorkStealingPool> computePool_;
+  std::shared_ptr<AdmissionController> admission_;
+  std::shared_ptr<JobManager> jobs_;
+  body_codec::CompressionSettings compression_;
+  size_t maxDecodedRequestBytes_;
+  size_t maxRequestBytes_;
+  size_t maxJobBytes_;
+  Pistache::Rest::Router router_;
 };
 
 #endif // REST_REQUEST_HANDLER_H
@@ -0,0 +1,348 @@
+#include "server_config.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include <sched.h>
+
+#include "nlohmann_json/json.hpp"
+
+using Json = nlohmann::json;
+
+namespace server_config
+{
+
+namespace
+{
+
+const std::string configOption = "config";
+const std::string prefetchDictionariesOption = "prefetch-dictionaries";
+const std::string warmupCorpusOption = "warmup-corpus";
+
+size_t parseSize(const std::string& option, const std::string& value)
+{
+  if (!value.empty() && std::isdigit(static_cast<unsigned char>(value.front())))
+  {
+    try
+    {
+      size_t parsedLength = 0;
+      const auto size = std::stoull(value, &parsedLength);
+      if (parsedLength == value.size())
+        return size;
+    }
+    catch (const std::out_of_range&)
+    {
+    }
+  }
+
+  throw std::invalid_argument("Option " + option + " expects a non-negative number, got " + value);
+}
+
+int parseLevel(const std::string& option, const std::string& value, int minLevel, int maxLevel)
+{
+  const auto level = parseSize(option, value);
+  if (level < static_cast<size_t>(minLevel) || level > static_cast<size_t>(maxLevel))
+    throw std::invalid_argument("Option " + option + " expects a number between "
+                                + std::to_string(minLevel) + " and " + std::to_string(maxLevel));
+  return static_cast<int>(level);
+}
+
+void applyOption(ServerConfig& config, const std::string& option, const std::string& value)
+{
+  if (option == "port")
+  {
+    const auto port = parseSize(option, value);
+    if (port > std::numeric_limits<uint16_t>::max())
+      throw std::invalid_argument("Option port expects a number between 0 and 65535");
+    config.port = static_cast<uint16_t>(port);
+  }
+  else if (option == "unix-socket")
+    config.unixSocketPath = value;
+  else if (option == "workers")
+    config.workerCount = parseSize(option, value);
+  else if (option == "threads")
+    config.threadCount = parseSize(option, value);
+  else if (option == "compute-threads")
+    config.computeThreadCount = parseSize(option, value);
+  else if (option == "lemmatizers")
+    config.lemmatizerCount = parseSize(option, value);
+  else if (option == "max-request-bytes")
+    config.maxRequestBytes = parseSize(option, value);
+  else if (option == "max-response-bytes")
+    config.maxResponseBytes = parseSize(option, value);
+  else if (option == "max-decoded-request-bytes")
+    config.maxDecodedRequestBytes = parseSize(option, value);
+  else if (option == "admission-queue-bytes")
+    config.admissionQueueBytes = parseSize(option, value);
+  else if (option == "job-directory")
+    config.jobDirectory = value;
+  else if (option == "max-job-bytes")
+    config.maxJobBytes = parseSize(option, value);
+  else if (option == "job-threads")
+    config.jobThreadCount = parseSize(option, value);
+  else if (option == "job-retention-seconds")
+    config.jobRetentionSeconds = parseSize(option, value);
+  else if (option == "gzip-level")
+    config.gzipLevel = parseLevel(option, value, 1, 9);
+  else if (option == "zstd-level")
+    config.zstdLevel = parseLevel(option, value, 1, 19);
+  else if (option == "compress-min-bytes")
+    config.compressionMinBytes = parseSize(option, value);
+  else if (option == prefetchDictionariesOption)
+    config.dictionaryPrefetchPaths.emplace_back(value);
+  else if (option == "lemma-cache-mb")
+    config.lemmaCacheBytes = parseSize(option, value)*1024*1024;
+  else if (option == "lemma-store")
+    config.lemmaStorePath = value;
+  else if (option == "lemma-store-mb")
+    config.lemmaStoreMaxBytes = parseSize(option, value)*1024*1024;
+  else if (option == "dictionary-version")
+    config.dictionaryVersion = value;
+  else if (option == warmupCorpusOption)
+    config.warmupCorpusPaths.emplace_back(value);
+  else if (option == "warmup-seconds")
+    config.warmupSeconds = parseSize(option, value);
+  else if (option == "warmup-threads")
+    config.warmupThreadCount = parseSize(option, value);
+  else
+    throw std::invalid_argument("Unknown option " + option);
+}
+
+std::string jsonOptionValue(const std::string& option, const Json& value)
+{
+  if (value.is_string())
+    return value.get<std::string>();
+  if (value.is_number_unsigned())
+    return std::to_string(value.get<uint64_t>());
+
+  throw std::invalid_argument("Option " + option + " in the config file must be a string "
+                              "or a non-negative integer");
+}
+
+void applyConfigFile(ServerConfig& config, const std::filesystem::path& path)
+{
+  std::ifstream configFile(path);
+  if (!configFile.good())
+    throw std::invalid_argument("Failed to open config file " + path.string());
+
+  Json configJson;
+  try
+  {
+    configFile >> configJson;
+  }
+  catch (const Json::exception& exception)
+  {
+    throw std::invalid_argument("Invalid config file " + path.string() + ": " + exception.what());
+  }
+
+  if (!configJson.is_object())
+    throw std::invalid_argument("Config file " + path.string() + " must hold a JSON object");
+
+  for (const auto& [option, value] : configJson.items())
+  {
+    if (value.is_array())
+    {
+      for (const auto& element : value)
+        applyOption(config, option, jsonOptionValue(option, element));
+      continue;
+    }
+    applyOption(config, option, jsonOptionValue(option, value));
+  }
+}
+
+std::vector<std::pair<std::string, std::string>> readCommandLineOptions(int argc, char* argv[])
+{
+  std::vector<std::pair<std::string, std::string>> options;
+  for (int argIndex = 1; argIndex < argc; ++argIndex)
+  {
+    const std::string argument = argv[argIndex];
+    if (argument.rfind("--", 0) != 0)
+      throw std::invalid_argument("Unexpected argument " + argument);
+    if (argIndex + 1 >= argc)
+      throw std::invalid_argument("Option " + argument + " requires a value");
+
+    options.emplace_back(argument.substr(2), argv[++argIndex]);
+  }
+  return options;
+}
+
+// Repeatable options given on the command line replace the config file's list instead of adding
+// to it, like every other option.
+void clearListOptions(ServerConfig& config, const std::set<std::string>& commandLineOptionNames)
+{
+  if (commandLineOptionNames.count(prefetchDictionariesOption) != 0)
+    config.dictionaryPrefetchPaths.clear();
+  if (commandLineOptionNames.count(warmupCorpusOption) != 0)
+    config.warmupCorpusPaths.clear();
+}
+
+}
+
+std::optional<double> readCgroupCpuLimit(const std::filesystem::path& cgroupRoot)
+{
+  // cgroup v2: "<quota> <period>" or "max <period>"
+  std::ifstream cpuMax(cgroupRoot / "cpu.max");
+  std::string quota;
+  double period = 0;
+  if (cpuMax >> quota >> period)
+  {
+    if (quota == "max" || period <= 0)
+      return std::nullopt;
+    return std::stod(quota) / period;
+  }
+
+  // cgroup v1: a quota of -1 means unlimited
+  std::ifstream cfsQuota(cgroupRoot / "cpu" / "cpu.cfs_quota_us");
+  std::ifstream cfsPeriod(cgroupRoot / "cpu" / "cpu.cfs_period_us");
+  double quotaMicroseconds = 0;
+  double periodMicroseconds = 0;
+  if (cfsQuota >> quotaMicroseconds && cfsPeriod >> periodMicroseconds
+      && quotaMicroseconds > 0 && periodMicroseconds > 0)
+    return quotaMicroseconds / periodMicroseconds;
+
+  return std::nullopt;
+}
+
+ServerConfig parseCommandLine(int argc, char* argv[])
+{
+  ServerConfig config;
+  const auto commandLineOptions = readCommandLineOptions(argc, argv);
+
+  std::set<std::string> commandLineOptionNames;
+  for (const auto& [option, value] : commandLineOptions)
+  {
+    commandLineOptionNames.insert(option);
+    if (option == configOption)
+      applyConfigFile(config, value);
+  }
+  clearListOptions(config, commandLineOptionNames);
+
+  for (const auto& [option, value] : commandLineOptions)
+  {
+    if (option != configOption)
+      applyOption(config, option, value);
+  }
+
+  if (config.port == 0 && config.unixSocketPath.empty())
+    throw std::invalid_argument("Port 0 disables TCP, so option unix-socket is required");
+  // SO_REUSEPORT doesn't apply to Unix domain sockets, so workers couldn't share the path.
+  if (config.workerCount > 0 && !config.unixSocketPath.empty())
+    throw std::invalid_argument("Option unix-socket can't be combined with workers");
+  // Jobs are known only to the process that accepted them, and a worker can't tell which one
+  // the next request on the port reaches.
+  if (config.workerCount > 0 && !config.jobDirectory.empty())
+    throw std::invalid_argument("Option job-directory can't be combined with workers");
+  if (config.jobThreadCount == 0)
+    throw std::invalid_argument("Option job-threads must be at least 1");
+
+  return config;
+}
+
+void resolveAutomaticSizes(ServerConfig& config)
+{
+  // Prefork workers split the CPUs between them.
+  const size_t cpuCount = config.workerCount > 0
+      ? std::max<size_t>(availableCpuCount() / config.workerCount, 1)
+      : availableCpuCount();
+  if (config.threadCount == 0)
+    config.threadCount = cpuCount;
+  if (config.computeThreadCount == 0)
+    config.computeThreadCount = cpuCount;
+  if (config.lemmatizerCount == 0)
+    config.lemmatizerCount = config.computeThreadCount;
+  if (config.admissionQueueBytes == 0)
+    config.admissionQueueBytes = 2*config.computeThreadCount*config.maxRequestBytes;
+}
+
+size_t availableCpuCount()
+{
+  size_t cpuCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+  cpu_set_t affinity;
+  if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0)
+    cpuCount = std::min<size_t>(cpuCount, std::max(CPU_COUNT(&affinity), 1));
+
+  try
+  {
+    if (const auto cpuLimit = readCgroupCpuLimit())
+      cpuCount = std::min<size_t>(cpuCount, std::max<size_t>(std::ceil(*cpuLimit), 1));
+  }
+  catch (const std::logic_error&)
+  {
+  }
+
+  return cpuCount;
+}
+
+std::string usage(const std::string& programName)
+{
+  return "Usage: " + programName + " [options]\n"
+         "  --config <path>                  JSON file with any of the options below, e.g.\n"
+         "                                   {\"port\": 5000, \"warmup-corpus\": [\"a.jsonl\"]}.\n"
+         "                                   Command line options override it.\n"
+         "  --port <port>                    Listening port; 0 disables TCP. Default: 5000.\n"
+         "  --unix-socket <path>             Also serve on this Unix domain socket, e.g. for a\n"
+         "                                   caller in the same pod. Not with --workers.\n"
+         "  --workers <count>                Serve from this many forked worker processes that\n"
+         "                                   share the port (SO_REUSEPORT) and the lemmatizer\n"
+         "                                   loaded by the parent, which restarts a worker that\n"
+         "                                   dies; 0 serves from this process. Default: 0.\n"
+         "  --threads <count>                Server I/O threads; 0 uses one per available CPU,\n"
+         "                                   honouring the cgroup CPU quota. Default: 0.\n"
+         "                                   With --workers, per worker, from its share of CPUs.\n"
+         "  --compute-threads <count>        Threads that parse, lemmatize and serialise requests;\n"
+         "                                   0 uses one per available CPU. Default: 0.\n"
+         "                                   With --workers, per worker, from its share of CPUs.\n"
+         "  --lemmatizers <count>            Maximum number of lemmatizer instances; 0 matches\n"
+         "                                   the compute thread count. Default: 0.\n"
+         "  --max-request-bytes <size>       Request size limit. Default: 1048576.\n"
+         "  --max-response-bytes <size>      Response size limit. Default: 1048576.\n"
+         "  --max-decoded-request-bytes <size>\n"
+         "                                   Size limit of a gzip or zstd request body after\n"
+         "                                   decompression. Default: 67108864.\n"
+         "  --admission-queue-bytes <size>   Request bytes accepted for lemmatization but not yet\n"
+         "                                   answered; beyond it requests get 503 at once. 0 uses\n"
+         "                                   twice the compute thread count times\n"
+         "                                   --max-request-bytes. Default: 0.\n"
+         "  --job-directory <path>           Enables the jobs API (/v1/jobs): NDJSON uploads are\n"
+         "                                   spooled to this directory, lemmatized in the\n"
+         "                                   background and their results kept there. Not with\n"
+         "                                   --workers.\n"
+         "  --max-job-bytes <size>           Job upload size limit. Default: 268435456.\n"
+         "  --job-threads <count>            Threads that run jobs, apart from the compute\n"
+         "                                   threads. Default: 1.\n"
+         "  --job-retention-seconds <seconds>\n"
+         "                                   How long finished jobs and their results are kept;\n"
+         "                                   0 keeps them until deleted. Default: 86400.\n"
+         "  --gzip-level <level>             gzip response compression level, 1-9. Default: 6.\n"
+         "  --zstd-level <level>             zstd response compression level, 1-19. Default: 3.\n"
+         "  --compress-min-bytes <size>      Responses smaller than this are not compressed.\n"
+         "                                   Default: 1024.\n"
+         "  --prefetch-dictionaries <path>   Read Polem's dictionary files (or a directory of them)\n"
+         "                                   into the page cache before assembling the lemmatizer.\n"
+         "                                   May be repeated.\n"
+         "  --lemma-cache-mb <size>          Memory budget of the lemmatization result cache;\n"
+         "                                   0 disables the cache. Default: 64.\n"
+         "  --lemma-store <path>             File the lemma cache is persisted to and restored\n"
+         "                                   from at startup.\n"
+         "  --lemma-store-mb <size>          Size limit of the lemma store file. Default: 256.\n"
+         "  --dictionary-version <string>    Identifies Polem's dictionaries; together with the\n"
+         "                                   files given to --prefetch-dictionaries it keys the\n"
+         "                                   lemma store and the cache, so changing either\n"
+         "                                   discards them. Without either, every reload starts\n"
+         "                                   with an empty cache.\n"
+         "  --warmup-corpus <path>           .json or .jsonl corpus lemmatized before the server\n"
+         "                                   starts, to fill the lemma cache. May be repeated.\n"
+         "  --warmup-seconds <seconds>       Time limit of the warm-up. Default: 30.\n"
+         "  --warmup-threads <count>         Warm-up threads, at most one per lemmatizer; 0 uses\n"
+         "                                   one per lemmatizer. Default: 0.\n";
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct ServerConfig
+{
+  // 0 disables the TCP listener.
+  uint16_t port = 5000;
+  std::filesystem::path unixSocketPath;
+  size_t workerCount = 0;
+  size_t threadCount = 0;
+  size_t computeThreadCount = 0;
+  size_t lemmatizerCount = 0;
+  size_t maxRequestBytes = 1024*1024;
+  size_t maxResponseBytes = 1024*1024;
+  size_t maxDecodedRequestBytes = 64*1024*1024;
+  size_t admissionQueueBytes = 0;
+  // Empty disables the jobs API.
+  std::filesystem::path jobDirectory;
+  size_t maxJobBytes = 256*1024*1024;
+  size_t jobThreadCount = 1;
+  size_t jobRetentionSeconds = 24*60*60;
+  int gzipLevel = 6;
+  int zstdLevel = 3;
+  size_t compressionMinBytes = 1024;
+  std::vector<std::filesystem::path> dictionaryPrefetchPaths;
+  size_t lemmaCacheBytes = 64*1024*1024;
+  std::filesystem::path lemmaStorePath;
+  size_t lemmaStoreMaxBytes = 256*1024*1024;
+  std::string dictionaryVersion;
+  std::vector<std::filesystem::path> warmupCorpusPaths;
+  size_t warmupSeconds = 30;
+  size_t warmupThreadCount = 0;
+};
+
+namespace server_config
+{
+
+// Options are read from the JSON object in the file given with --config first (keys are the
+// option names without the leading dashes), then from the command line, which takes precedence.
+ServerConfig parseCommandLine(int argc, char* argv[]);
+
+// Replaces the "use the default" zeros of the sizing options with values derived from the CPUs
+// the process may actually use.
+void resolveAutomaticSizes(ServerConfig& config);
+
+// Number of CPUs available to the process, taking the affinity mask and the cgroup (v1 or v2)
+// CPU quota into account.
+size_t availableCpuCount();
+
+// The cgroup CPU quota in CPUs, if there is one, from the cgroup file system at `cgroupRoot`.
+// Throws std::logic_error if the quota file is malformed.
+std::optional<double> readCgroupCpuLimit(
+    const std::filesystem::path& cgroupRoot = "/sys/fs/cgroup");
+
+std::string usage(const std::string& programName);
+
+}
+
+#endif // SERVER_CONFIG_H
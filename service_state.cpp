@@ -0,0 +1,98 @@
+#include "service_state.h"
+
+ServiceState::ServiceState(std::shared_ptr<LemmaCache> lemmaCache)
+  : lemmaCache_(std::move(lemmaCache))
+{
+}
+
+std::shared_ptr<LemmatizerPool> ServiceState::lemmatizerPool() const
+{
+  std::lock_guard<std::mutex> lock(lemmatizerMutex_);
+  return lemmatizerPool_;
+}
+
+std::shared_ptr<LemmatizerPool>
+ServiceState::lemmatizerPool(std::shared_ptr<LemmaCache>& lemmaCache) const
+{
+  std::lock_guard<std::mutex> lock(lemmatizerMutex_);
+  lemmaCache = lemmaCache_;
+  return lemmatizerPool_;
+}
+
+void ServiceState::setLemmatizerPool(std::shared_ptr<LemmatizerPool> lemmatizerPool)
+{
+  std::lock_guard<std::mutex> lock(lemmatizerMutex_);
+  lemmatizerPool_ = std::move(lemmatizerPool);
+}
+
+void ServiceState::setLemmatizerPool(std::shared_ptr<LemmatizerPool> lemmatizerPool,
+                                     std::shared_ptr<LemmaCache> lemmaCache)
+{
+  std::lock_guard<std::mutex> lock(lemmatizerMutex_);
+  lemmatizerPool_ = std::move(lemmatizerPool);
+  lemmaCache_ = std::move(lemmaCache);
+}
+
+std::shared_ptr<LemmaCache> ServiceState::lemmaCache() const
+{
+  std::lock_guard<std::mutex> lock(lemmatizerMutex_);
+  return lemmaCache_;
+}
+
+std::shared_ptr<LemmaStore> ServiceState::lemmaStore() const
+{
+  return std::atomic_load(&lemmaStore_);
+}
+
+void ServiceState::setLemmaStore(std::shared_ptr<LemmaStore> lemmaStore)
+{
+  std::atomic_store(&lemmaStore_, std::move(lemmaStore));
+}
+
+bool ServiceState::requestReload()
+{
+  {
+    std::lock_guard<std::mutex> lock(reloadMutex_);
+    if (reloadPending_ || reloading_)
+      return false;
+    reloadPending_ = true;
+  }
+  reloadRequested_.notify_one();
+  return true;
+}
+
+void ServiceState::waitForReloadRequest()
+{
+  std::unique_lock<std::mutex> lock(reloadMutex_);
+  reloadRequested_.wait(lock, [this]{ return reloadPending_; });
+  reloadPending_ = false;
+  reloading_ = true;
+}
+
+void ServiceState::finishReload()
+{
+  std::lock_guard<std::mutex> lock(reloadMutex_);
+  reloading_ = false;
+}
+
+bool ServiceState::isReloading() const
+{
+  std::lock_guard<std::mutex> lock(reloadMutex_);
+  return reloadPending_ || reloading_;
+}
+
+std::string ServiceState::statusName(Status status)
+{
+  switch (status)
+  {
+  case Status::Loading:
+    return "loading";
+  case Status::WarmingUp:
+    return "warming up";
+  case Status::Ready:
+    return "ready";
+  case Status::Failed:
+    return "failed";
+  }
+  return "unknown";
+}
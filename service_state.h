@@ -0,0 +1,69 @@
+#ifndef SERVICE_STATE_H
+#define SERVICE_STATE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class LemmaCache;
+class LemmaStore;
+class LemmatizerPool;
+
+// State shared by all request handlers. The lemmatizers are assembled in the background after
+// the listener is up, so until the service reports Ready there is no pool to lemmatize with.
+// A reload publishes a new pool the same way; requests that already took the old one finish
+// on it and it is released after the last of them. A reload with new dictionaries publishes a
+// new, empty lemma cache together with the pool, so that no request mixes the two.
+class ServiceState
+{
+public:
+  enum class Status
+  {
+    Loading,
+    WarmingUp,
+    Ready,
+    Failed
+  };
+
+  explicit ServiceState(std::shared_ptr<LemmaCache> lemmaCache);
+
+  Status status() const { return status_; }
+  void setStatus(Status status) { status_ = status; }
+  bool isReady() const { return status_ == Status::Ready; }
+
+  std::shared_ptr<LemmatizerPool> lemmatizerPool() const;
+  // The pool together with the cache of its results.
+  std::shared_ptr<LemmatizerPool> lemmatizerPool(std::shared_ptr<LemmaCache>& lemmaCache) const;
+  void setLemmatizerPool(std::shared_ptr<LemmatizerPool> lemmatizerPool);
+  void setLemmatizerPool(std::shared_ptr<LemmatizerPool> lemmatizerPool,
+                         std::shared_ptr<LemmaCache> lemmaCache);
+
+  std::shared_ptr<LemmaCache> lemmaCache() const;
+
+  std::shared_ptr<LemmaStore> lemmaStore() const;
+  void setLemmaStore(std::shared_ptr<LemmaStore> lemmaStore);
+
+  // Returns false if a reload is already pending or in progress.
+  bool requestReload();
+  void waitForReloadRequest();
+  void finishReload();
+  bool isReloading() const;
+
+  static std::string statusName(Status status);
+
+private:
+  std::atomic<Status> status_ {Status::Loading};
+  mutable std::mutex lemmatizerMutex_;
+  std::shared_ptr<LemmatizerPool> lemmatizerPool_;
+  std::shared_ptr<LemmaCache> lemmaCache_;
+  std::shared_ptr<LemmaStore> lemmaStore_;
+
+  mutable std::mutex reloadMutex_;
+  std::condition_variable reloadRequested_;
+  bool reloadPending_ = false;
+  bool reloading_ = false;
+};
+
+#endif // SERVICE_STATE_H
@@ -0,0 +1,69 @@
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+
+#include "../admission_controller.h"
+
+BOOST_AUTO_TEST_SUITE(admission_controller_tests)
+
+BOOST_AUTO_TEST_CASE(rejects_work_beyond_the_capacity_until_units_are_released)
+{
+  auto controller = std::make_shared<AdmissionController>(100);
+
+  auto first = controller->tryAdmit(60);
+  auto second = controller->tryAdmit(40);
+  BOOST_REQUIRE(first);
+  BOOST_REQUIRE(second);
+  BOOST_TEST(!controller->tryAdmit(1));
+
+  first.reset();
+  BOOST_TEST(controller->tryAdmit(60) != nullptr);
+
+  const auto statistics = controller->statistics();
+  BOOST_CHECK_EQUAL(statistics.admitted, 3u);
+  BOOST_CHECK_EQUAL(statistics.rejected, 1u);
+  BOOST_CHECK_EQUAL(statistics.units, 40u);
+  BOOST_CHECK_EQUAL(statistics.requests, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(admits_an_oversized_request_when_idle)
+{
+  auto controller = std::make_shared<AdmissionController>(100);
+
+  auto large = controller->tryAdmit(500);
+  BOOST_REQUIRE(large);
+  BOOST_TEST(!controller->tryAdmit(1));
+}
+
+BOOST_AUTO_TEST_CASE(counts_waiting_requests_until_started)
+{
+  auto controller = std::make_shared<AdmissionController>(0);
+
+  auto ticket = controller->tryAdmit(10);
+  BOOST_CHECK_EQUAL(controller->statistics().waiting, 1u);
+
+  ticket->start();
+  ticket->start();
+  BOOST_CHECK_EQUAL(controller->statistics().waiting, 0u);
+  BOOST_CHECK_EQUAL(controller->statistics().requests, 1u);
+
+  ticket.reset();
+  BOOST_CHECK_EQUAL(controller->statistics().requests, 0u);
+  BOOST_CHECK_EQUAL(controller->statistics().waiting, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(refuses_every_request_once_closed)
+{
+  auto controller = std::make_shared<AdmissionController>(0);
+  auto admitted = controller->tryAdmit(10);
+
+  controller->close();
+  BOOST_TEST(!controller->tryAdmit(1));
+  BOOST_CHECK_EQUAL(controller->statistics().requests, 1u);
+
+  admitted.reset();
+  BOOST_TEST(!controller->tryAdmit(1));
+  BOOST_CHECK_EQUAL(controller->statistics().rejected, 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../body_codec.h"
+
+namespace
+{
+
+std::string encode(body_codec::Encoding encoding, const std::string& input, size_t pieceBytes)
+{
+  auto encoder = body_codec::makeEncoder(encoding, body_codec::CompressionSettings());
+  std::string output;
+  const auto sink = [&output](std::string_view part){ output += part; };
+  for (size_t offset = 0; offset < input.size(); offset += pieceBytes)
+    encoder->write(std::string_view(input).substr(offset, pieceBytes), sink);
+  encoder->finish(sink);
+  return output;
+}
+
+std::string makeLabelsJson(size_t labelCount)
+{
+  std::string json = "[";
+  for (size_t i = 0; i < labelCount; ++i)
+    json += R"({"serviceName": "tagger", "fieldName": "posTag", "startToken": )"
+            + std::to_string(i) + "},";
+  json.back() = ']';
+  return json;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(body_codec_tests)
+
+BOOST_AUTO_TEST_CASE(gzip_flush_emits_what_was_written_and_still_round_trips)
+{
+  auto encoder = body_codec::makeEncoder(body_codec::Encoding::Gzip,
+                                         body_codec::CompressionSettings());
+  std::string output;
+  const auto sink = [&output](std::string_view part){ output += part; };
+
+  encoder->write("{\"docs\": 1}\n", sink);
+  encoder->flush(sink);
+  const size_t flushedBytes = output.size();
+  BOOST_TEST(flushedBytes > 0u);
+
+  encoder->write("{\"docs\": 2}\n", sink);
+  encoder->flush(sink);
+  BOOST_TEST(output.size() > flushedBytes);
+
+  encoder->finish(sink);
+  BOOST_CHECK_EQUAL(body_codec::decode(body_codec::Encoding::Gzip, output, 1024),
+                    "{\"docs\": 1}\n{\"docs\": 2}\n");
+}
+
+BOOST_AUTO_TEST_CASE(gzip_round_trips_a_body_written_in_pieces)
+{
+  const auto input = makeLabelsJson(5000);
+
+  const auto compressed = encode(body_codec::Encoding::Gzip, input, 1000);
+
+  BOOST_TEST(compressed.size() < input.size() / 5);
+  BOOST_CHECK_EQUAL(body_codec::decode(body_codec::Encoding::Gzip, compressed, input.size()), input);
+}
+
+BOOST_AUTO_TEST_CASE(gzip_decodes_concatenated_members)
+{
+  const auto compressed = encode(body_codec::Encoding::Gzip, "first ", 100)
+                          + encode(body_codec::Encoding::Gzip, "second", 100);
+
+  BOOST_CHECK_EQUAL(body_codec::decode(body_codec::Encoding::Gzip, compressed, 100), "first second");
+}
+
+BOOST_AUTO_TEST_CASE(decode_rejects_bodies_over_the_limit_and_corrupt_input)
+{
+  const auto input = makeLabelsJson(1000);
+  const auto compressed = encode(body_codec::Encoding::Gzip, input, input.size());
+
+  BOOST_CHECK_THROW(body_codec::decode(body_codec::Encoding::Gzip, compressed, input.size() - 1),
+                    body_codec::DecodedBodyTooLarge);
+  BOOST_CHECK_THROW(body_codec::decode(body_codec::Encoding::Gzip,
+                                       compressed.substr(0, compressed.size() / 2),
+                                       input.size()),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(body_codec::decode(body_codec::Encoding::Gzip, "not gzip", input.size()),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(selectResponseEncoding_honours_quality_values)
+{
+  using body_codec::Encoding;
+
+  BOOST_TEST((body_codec::selectResponseEncoding("gzip, deflate") == Encoding::Gzip));
+  BOOST_TEST((body_codec::selectResponseEncoding("deflate, br") == Encoding::Identity));
+  BOOST_TEST((body_codec::selectResponseEncoding("gzip;q=0, *") != Encoding::Gzip));
+  BOOST_TEST((body_codec::selectResponseEncoding("") == Encoding::Identity));
+}
+
+#ifdef WITH_ZSTD
+BOOST_AUTO_TEST_CASE(zstd_round_trips_a_body_written_in_pieces)
+{
+  const auto input = makeLabelsJson(5000);
+
+  const auto compressed = encode(body_codec::Encoding::Zstd, input, 1000);
+
+  BOOST_TEST(compressed.size() < input.size() / 5);
+  BOOST_CHECK_EQUAL(body_codec::decode(body_codec::Encoding::Zstd, compressed, input.size()), input);
+  BOOST_TEST((body_codec::selectResponseEncoding("gzip, zstd") == body_codec::Encoding::Zstd));
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,52 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../content_negotiation.h"
+
+BOOST_AUTO_TEST_SUITE(content_negotiation_tests)
+
+BOOST_AUTO_TEST_CASE(parseAcceptList_splits_values_parameters_and_quality)
+{
+  auto entries = content_negotiation::parseAcceptList(
+        "Application/JSON; Compact=true, text/plain;q=0.5 ,*/*; q=0");
+
+  BOOST_REQUIRE_EQUAL(entries.size(), 3u);
+  BOOST_CHECK_EQUAL(entries[0].value, "application/json");
+  BOOST_CHECK_EQUAL(entries[0].parameters.at("compact"), "true");
+  BOOST_CHECK_EQUAL(entries[0].quality, 1.0);
+  BOOST_CHECK_EQUAL(entries[1].value, "text/plain");
+  BOOST_CHECK_EQUAL(entries[1].quality, 0.5);
+  BOOST_TEST(entries[1].parameters.empty());
+  BOOST_CHECK_EQUAL(entries[2].value, "*/*");
+  BOOST_CHECK_EQUAL(entries[2].quality, 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(parseAcceptList_ignores_empty_elements_and_unquotes_values)
+{
+  auto entries = content_negotiation::parseAcceptList(" , gzip;level=\"3\",");
+
+  BOOST_REQUIRE_EQUAL(entries.size(), 1u);
+  BOOST_CHECK_EQUAL(entries[0].value, "gzip");
+  BOOST_CHECK_EQUAL(entries[0].parameters.at("level"), "3");
+}
+
+BOOST_AUTO_TEST_CASE(findMediaTypeParameter_only_looks_at_the_given_media_type)
+{
+  const std::string accept = "text/plain; compact=false, application/json; compact";
+
+  auto compact = content_negotiation::findMediaTypeParameter(accept, "application/json", "compact");
+
+  BOOST_REQUIRE(compact.has_value());
+  BOOST_TEST(content_negotiation::isFlagEnabled(compact));
+  BOOST_TEST(!content_negotiation::findMediaTypeParameter("*/*", "application/json", "compact"));
+}
+
+BOOST_AUTO_TEST_CASE(isFlagEnabled_accepts_true_one_and_bare_flags)
+{
+  BOOST_TEST(content_negotiation::isFlagEnabled(std::string("TRUE")));
+  BOOST_TEST(content_negotiation::isFlagEnabled(std::string("1")));
+  BOOST_TEST(content_negotiation::isFlagEnabled(std::string()));
+  BOOST_TEST(!content_negotiation::isFlagEnabled(std::string("false")));
+  BOOST_TEST(!content_negotiation::isFlagEnabled(std::nullopt));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
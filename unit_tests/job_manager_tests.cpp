@@ -0,0 +1,160 @@
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+#include "../job_manager.h"
+#include "../lemmatizer_pool.h"
+#include "../service_state.h"
+
+namespace
+{
+
+constexpr std::chrono::steady_clock::duration retention = std::chrono::hours(1);
+
+// A fresh spool directory, removed with everything in it at the end of the test.
+struct SpoolDirectory
+{
+  SpoolDirectory()
+    : path(std::filesystem::temp_directory_path()
+           / ("job_manager_tests_" + std::to_string(::getpid())))
+  {
+    std::filesystem::remove_all(path);
+  }
+  ~SpoolDirectory()
+  {
+    std::filesystem::remove_all(path);
+  }
+
+  std::filesystem::path path;
+};
+
+std::shared_ptr<ServiceState> makeReadyState()
+{
+  auto state = std::make_shared<ServiceState>(nullptr);
+  state->setLemmatizerPool(std::make_shared<LemmatizerPool>(1, 1));
+  state->setStatus(ServiceState::Status::Ready);
+  return state;
+}
+
+JobManager::Progress waitUntilFinished(const JobManager& jobs, const std::string& id)
+{
+  for (int attempt = 0; attempt < 500; ++attempt)
+  {
+    const auto progress = jobs.progress(id);
+    BOOST_REQUIRE(progress);
+    if (progress->status == JobManager::Status::Done
+        || progress->status == JobManager::Status::Failed)
+      return *progress;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_FAIL("Job " + id + " didn't finish");
+  return {};
+}
+
+std::string readFile(const std::filesystem::path& path)
+{
+  std::ifstream file(path);
+  std::ostringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(job_manager_tests)
+
+BOOST_AUTO_TEST_CASE(processes_a_spooled_job_line_by_line)
+{
+  SpoolDirectory directory;
+  JobManager jobs(directory.path, 1, retention, makeReadyState());
+
+  const std::string input = "{\"labels\": []}\n\nnot json\n{\"labels\": []}\n";
+  const auto id = jobs.submit(input);
+  const auto progress = waitUntilFinished(jobs, id);
+
+  BOOST_TEST((progress.status == JobManager::Status::Done));
+  BOOST_CHECK_EQUAL(progress.inputBytes, input.size());
+  BOOST_CHECK_EQUAL(progress.processedBytes, input.size());
+  BOOST_CHECK_EQUAL(progress.docs, 2);
+  BOOST_CHECK_EQUAL(progress.failedLines, 1);
+
+  const auto resultPath = jobs.resultPath(id);
+  BOOST_REQUIRE(resultPath);
+  const auto result = readFile(*resultPath);
+  BOOST_CHECK_EQUAL(std::count(result.begin(), result.end(), '\n'), 3);
+  BOOST_TEST(result.find("\"line\":3") != std::string::npos);
+
+  // Only the result is kept.
+  BOOST_CHECK_EQUAL(std::distance(std::filesystem::directory_iterator(directory.path),
+                                  std::filesystem::directory_iterator()), 1);
+}
+
+BOOST_AUTO_TEST_CASE(fails_jobs_without_a_lemmatizer)
+{
+  SpoolDirectory directory;
+  JobManager jobs(directory.path, 1, retention, std::make_shared<ServiceState>(nullptr));
+
+  const auto id = jobs.submit("{\"labels\": []}\n");
+  const auto progress = waitUntilFinished(jobs, id);
+
+  BOOST_TEST((progress.status == JobManager::Status::Failed));
+  BOOST_TEST(!progress.error.empty());
+  BOOST_TEST(!jobs.resultPath(id));
+}
+
+BOOST_AUTO_TEST_CASE(removes_jobs_with_their_files)
+{
+  SpoolDirectory directory;
+  JobManager jobs(directory.path, 1, retention, makeReadyState());
+
+  const auto id = jobs.submit("{\"labels\": []}\n");
+  waitUntilFinished(jobs, id);
+
+  BOOST_TEST(jobs.remove(id));
+  BOOST_TEST(!jobs.progress(id).has_value());
+  BOOST_TEST(!jobs.remove(id));
+  BOOST_TEST(std::filesystem::is_empty(directory.path));
+}
+
+BOOST_AUTO_TEST_CASE(removes_files_left_by_an_earlier_run)
+{
+  SpoolDirectory directory;
+  std::filesystem::create_directories(directory.path);
+  for (const auto* name : {"a.input.ndjson", "a.result.ndjson.part", "b.result.ndjson",
+                           "notes.txt"})
+    std::ofstream(directory.path / name) << "{}\n";
+
+  JobManager jobs(directory.path, 1, retention, makeReadyState());
+
+  BOOST_CHECK_EQUAL(std::distance(std::filesystem::directory_iterator(directory.path),
+                                  std::filesystem::directory_iterator()), 1);
+  BOOST_TEST(std::filesystem::exists(directory.path / "notes.txt"));
+}
+
+BOOST_AUTO_TEST_CASE(removes_finished_jobs_after_the_retention_time)
+{
+  SpoolDirectory directory;
+  JobManager jobs(directory.path, 1, std::chrono::milliseconds(50), makeReadyState());
+
+  const auto id = jobs.submit("{\"labels\": []}\n");
+  waitUntilFinished(jobs, id);
+  const auto resultPath = jobs.resultPath(id);
+  BOOST_REQUIRE(resultPath);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const auto nextId = jobs.submit("{\"labels\": []}\n");
+
+  BOOST_TEST(!jobs.progress(id).has_value());
+  BOOST_TEST(!std::filesystem::exists(*resultPath));
+  BOOST_TEST(jobs.progress(nextId).has_value());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
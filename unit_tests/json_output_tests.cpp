@@ -0,0 +1,106 @@
+#include <boost/test/unit_test.hpp>
+
+#include <iomanip>
+#include <sstream>
+
+#include "../json_output.h"
+
+using Json = nlohmann::json;
+
+namespace
+{
+
+std::string serializeByDoc(const Json& json, int indent, size_t* sinkCalls = nullptr)
+{
+  std::string output;
+  json_output::serializeByDoc(json, indent, [&](std::string_view part)
+  {
+    output += part;
+    if (sinkCalls)
+      ++*sinkCalls;
+  });
+  return output;
+}
+
+const Json testJson = R"({
+  "count": 2,
+  "docs": [
+    {"labels": [{"value": "Alejach \"Jerozolimskich\"", "startToken": 1}], "text": "zażółć"},
+    {"labels": [], "nested": {"empty": {}, "list": [1, 2.5, null, true]}}
+  ],
+  "source": {"name": "tests"}
+})"_json;
+
+}
+
+BOOST_AUTO_TEST_SUITE(json_output_tests)
+
+BOOST_AUTO_TEST_CASE(serializeByDoc_matches_pretty_printing_of_the_whole_json)
+{
+  std::stringstream expected;
+  expected << std::setw(2) << testJson;
+
+  BOOST_CHECK_EQUAL(serializeByDoc(testJson, 2), expected.str());
+}
+
+BOOST_AUTO_TEST_CASE(serializeByDoc_matches_compact_dump_for_negative_indent)
+{
+  BOOST_CHECK_EQUAL(serializeByDoc(testJson, -1), testJson.dump());
+}
+
+BOOST_AUTO_TEST_CASE(serializeByDoc_passes_every_doc_to_the_sink_separately)
+{
+  size_t sinkCalls = 0;
+  serializeByDoc(testJson, 2, &sinkCalls);
+
+  BOOST_CHECK_EQUAL(sinkCalls, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(serializeByDoc_passes_top_level_array_elements_to_the_sink_separately)
+{
+  const Json array = R"([{"docIndex": 0, "labels": [{"value": "a"}]}, {"docIndex": 3}])"_json;
+  std::stringstream expected;
+  expected << std::setw(2) << array;
+  size_t sinkCalls = 0;
+
+  BOOST_CHECK_EQUAL(serializeByDoc(array, 2, &sinkCalls), expected.str());
+  BOOST_CHECK_EQUAL(sinkCalls, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(serializeByDoc_handles_json_without_docs)
+{
+  const Json emptyDocs = R"({"docs": []})"_json;
+  std::stringstream expected;
+  expected << std::setw(2) << emptyDocs;
+
+  BOOST_CHECK_EQUAL(serializeByDoc(emptyDocs, 2), expected.str());
+  BOOST_CHECK_EQUAL(serializeByDoc(Json::array({1, 2}), -1), "[1,2]");
+}
+
+BOOST_AUTO_TEST_CASE(serializeBinaryByDoc_matches_the_library_encoders)
+{
+  Json manyDocs = testJson;
+  for (int i = 0; i < 70000; ++i)
+    manyDocs["docs"].push_back({{"docIndex", i}});
+  Json manyMembers;
+  for (int i = 0; i < 30; ++i)
+    manyMembers["member" + std::to_string(i)] = i;
+  manyMembers["docs"] = Json::array({1, 2, 3});
+
+  for (const auto& json : {testJson, manyDocs, manyMembers, Json::array({"a", 1}), Json("text")})
+  {
+    const auto cbor = Json::to_cbor(json);
+    const auto messagePack = Json::to_msgpack(json);
+
+    std::string output;
+    const auto sink = [&output](std::string_view part){ output += part; };
+    json_output::serializeBinaryByDoc(json, wire_format::WireFormat::Cbor, sink);
+    BOOST_TEST(output == std::string(cbor.begin(), cbor.end()));
+
+    output.clear();
+    json_output::serializeBinaryByDoc(json, wire_format::WireFormat::MessagePack, sink);
+    BOOST_TEST(output == std::string(messagePack.begin(), messagePack.end()));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -657,3 +657,237 @@ BOOST_AUTO_TEST_CASE(lemmatizeNerLabels_returns_correct_lemmatized_NER_labels)
 
 BOOST_AUTO_TEST_SUITE_END()
 
+
+BOOST_AUTO_TEST_SUITE(lemmatization_batch_tests)
+
+BOOST_AUTO_TEST_CASE(batch_returns_same_entry_for_identical_lemmatization_inputs)
+{
+  LemmatizationBatch batch;
+
+  auto firstEntry = batch.add("Jerozolimskich", "adj:pl:loc:f:pos", "jerozolimski");
+  auto secondEntry = batch.add("Jerozolimskich", "adj:pl:loc:f:pos", "jerozolimski");
+
+  BOOST_CHECK_EQUAL(firstEntry, secondEntry);
+  BOOST_CHECK_EQUAL(batch.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(batch_keeps_separate_entries_for_different_tags)
+{
+  LemmatizationBatch batch;
+
+  auto firstEntry = batch.add("Polska", "subst:sg:nom:f", "polska");
+  auto secondEntry = batch.add("Polska", "adj:sg:nom:f:pos", "polski");
+
+  BOOST_CHECK_NE(firstEntry, secondEntry);
+  BOOST_CHECK_EQUAL(batch.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(addNerLabelsToBatch_maps_repeated_spans_to_one_entry)
+{
+  auto testJson =
+    R"({
+      "labels":
+       [
+        {
+          "startToken": 1,
+          "endToken": 1,
+          "fieldName": "namedEntityML",
+          "name": "sys.Street",
+          "serviceName": "NER",
+          "value": "Jerozolimskich"
+        },
+        {
+          "startToken": 1,
+          "endToken": 1,
+          "fieldName": "namedEntityML",
+          "name": "sys.Settlement",
+          "serviceName": "NER",
+          "value": "Jerozolimskich"
+        },
+        {
+          "startToken": 0,
+          "endToken": 1,
+          "fieldName": "lemmas",
+          "value": ["aleja"]
+        },
+        {
+          "startToken": 0,
+          "endToken": 1,
+          "fieldName": "posTag",
+          "value": "subst:pl:loc:f"
+        },
+        {
+          "startToken": 1,
+          "endToken": 2,
+          "fieldName": "lemmas",
+          "value": ["jerozolimski"]
+        },
+        {
+          "startToken": 1,
+          "endToken": 2,
+          "fieldName": "posTag",
+          "value": "adj:pl:loc:f:pos"
+        }
+       ]
+    })"_json;
+
+  auto labelArray = testJson.at(key_names::labelsKey);
+  auto nerLabels = label_processing::findNerLabels(labelArray);
+  auto posTagValues = label_processing::buildTagValueList("posTag", labelArray);
+  auto lemmaTagValues = label_processing::buildTagValueList("lemmas", labelArray);
+  LemmatizationBatch batch;
+
+  auto batchEntries
+      = label_processing::addNerLabelsToBatch(nerLabels, posTagValues, lemmaTagValues, batch);
+
+  BOOST_REQUIRE_EQUAL(batchEntries.size(), 2u);
+  BOOST_CHECK_EQUAL(batchEntries[0], batchEntries[1]);
+  BOOST_CHECK_EQUAL(batch.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(findAndLemmatizeNerLabelsInDoc_appends_polem_labels_to_the_doc)
+{
+  auto testDoc =
+    R"({
+      "labels":
+       [
+        {
+          "startToken": 1,
+          "endToken": 1,
+          "fieldName": "namedEntityML",
+          "name": "sys.Settlement",
+          "serviceName": "NER",
+          "value": "Jerozolimskich"
+        },
+        {
+          "startToken": 0,
+          "endToken": 1,
+          "fieldName": "lemmas",
+          "value": ["aleja"]
+        },
+        {
+          "startToken": 0,
+          "endToken": 1,
+          "fieldName": "posTag",
+          "value": "subst:pl:loc:f"
+        },
+        {
+          "startToken": 1,
+          "endToken": 2,
+          "fieldName": "lemmas",
+          "value": ["jerozolimski"]
+        },
+        {
+          "startToken": 1,
+          "endToken": 2,
+          "fieldName": "posTag",
+          "value": "adj:pl:loc:f:pos"
+        }
+       ]
+    })"_json;
+  CascadeLemmatizer lemmatizer = CascadeLemmatizer::assembleLemmatizer();
+
+  label_processing::findAndLemmatizeNerLabelsInDoc(testDoc, lemmatizer);
+
+  const auto& labels = testDoc.at(key_names::labelsKey);
+  BOOST_REQUIRE_EQUAL(labels.size(), 6u);
+  BOOST_CHECK_EQUAL(labels.back().at(key_names::labelService), "Polem");
+  BOOST_CHECK_EQUAL(labels.back().at("value"), "jerozolimscy");
+}
+
+BOOST_AUTO_TEST_CASE(lemmatizeNerLabelsInJson_reports_labels_by_doc_index_without_modifying_json)
+{
+  auto testJson =
+    R"({
+      "docs":
+       [
+        {"text": "no labels"},
+        {
+          "labels":
+           [
+            {
+              "startToken": 0,
+              "endToken": 0,
+              "fieldName": "namedEntityML",
+              "name": "sys.Settlement",
+              "serviceName": "NER",
+              "value": "Jerozolimskich"
+            },
+            {
+              "startToken": 0,
+              "endToken": 1,
+              "fieldName": "lemmas",
+              "value": ["jerozolimski"]
+            },
+            {
+              "startToken": 0,
+              "endToken": 1,
+              "fieldName": "posTag",
+              "value": "adj:pl:loc:f:pos"
+            }
+           ]
+        }
+       ]
+    })"_json;
+  const auto inputJson = testJson;
+  CascadeLemmatizer lemmatizer = CascadeLemmatizer::assembleLemmatizer();
+
+  auto docLemmatizations = label_processing::lemmatizeNerLabelsInJson(testJson, lemmatizer);
+
+  BOOST_REQUIRE_EQUAL(docLemmatizations.size(), 1u);
+  BOOST_CHECK_EQUAL(docLemmatizations[0].docIndex, 1u);
+  BOOST_REQUIRE_EQUAL(docLemmatizations[0].lemmatizedLabels.size(), 1u);
+  BOOST_CHECK_EQUAL(docLemmatizations[0].lemmatizedLabels[0].at("value"), "jerozolimscy");
+  BOOST_TEST(testJson == inputJson);
+}
+
+BOOST_AUTO_TEST_CASE(lemmatizeNerLabelsInJson_lists_the_docs_left_when_stopped)
+{
+  auto testJson =
+    R"({
+      "docs":
+       [
+        {"text": "no labels"},
+        {
+          "labels":
+           [
+            {
+              "startToken": 0,
+              "endToken": 0,
+              "fieldName": "namedEntityML",
+              "name": "sys.Settlement",
+              "serviceName": "NER",
+              "value": "Jerozolimskich"
+            },
+            {
+              "startToken": 0,
+              "endToken": 1,
+              "fieldName": "lemmas",
+              "value": ["jerozolimski"]
+            },
+            {
+              "startToken": 0,
+              "endToken": 1,
+              "fieldName": "posTag",
+              "value": "adj:pl:loc:f:pos"
+            }
+           ]
+        },
+        {"text": "never reached"}
+       ]
+    })"_json;
+  CascadeLemmatizer lemmatizer = CascadeLemmatizer::assembleLemmatizer();
+
+  // Stops after the first two docs have been collected, before their labels are lemmatized.
+  size_t checks = 0;
+  const auto shouldStop = [&checks]{ return ++checks > 2; };
+  std::vector<size_t> skippedDocIndices;
+  auto docLemmatizations = label_processing::lemmatizeNerLabelsInJson(testJson, lemmatizer, nullptr,
+                                                                      shouldStop,
+                                                                      &skippedDocIndices);
+
+  BOOST_TEST(docLemmatizations.empty());
+  BOOST_TEST(skippedDocIndices == std::vector<size_t>({1, 2}), boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../lemma_cache.h"
+
+BOOST_AUTO_TEST_SUITE(lemma_cache_tests)
+
+BOOST_AUTO_TEST_CASE(lemma_cache_returns_inserted_lemma_for_equal_key)
+{
+  LemmaCache cache(1024*1024);
+  cache.insert({"Alejach Jerozolimskich", "aleja jerozolimski", "subst:pl:loc:f adj:pl:loc:f:pos"},
+               "aleje jerozolimskie");
+
+  auto lemma = cache.find({"Alejach Jerozolimskich",
+                           "aleja jerozolimski",
+                           "subst:pl:loc:f adj:pl:loc:f:pos"});
+
+  BOOST_REQUIRE(lemma.has_value());
+  BOOST_CHECK_EQUAL(*lemma, "aleje jerozolimskie");
+}
+
+BOOST_AUTO_TEST_CASE(lemma_cache_distinguishes_keys_by_tags)
+{
+  LemmaCache cache(1024*1024);
+  cache.insert({"Polska", "polska", "subst:sg:nom:f"}, "polska");
+
+  BOOST_TEST(!cache.find({"Polska", "polski", "adj:sg:nom:f:pos"}).has_value());
+  BOOST_TEST(cache.find({"Polska", "polska", "subst:sg:nom:f"}).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(lemma_cache_counts_hits_and_misses)
+{
+  LemmaCache cache(1024*1024);
+  cache.find({"Warszawy", "warszawa", "subst:sg:gen:f"});
+  cache.insert({"Warszawy", "warszawa", "subst:sg:gen:f"}, "warszawa");
+  cache.find({"Warszawy", "warszawa", "subst:sg:gen:f"});
+  cache.find({"Warszawy", "warszawa", "subst:sg:gen:f"});
+
+  auto statistics = cache.statistics();
+
+  BOOST_CHECK_EQUAL(statistics.hits, 2u);
+  BOOST_CHECK_EQUAL(statistics.misses, 1u);
+  BOOST_CHECK_EQUAL(statistics.entries, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(lemma_cache_stays_within_byte_budget)
+{
+  const LemmaKey sampleKey {"value_000", "lemma_000", "tag_000"};
+  const size_t budget = 10 * LemmaCache::entrySize(sampleKey, "lemma_000");
+  LemmaCache cache(budget, 1);
+
+  for (int i = 0; i < 100; ++i)
+  {
+    auto suffix = std::to_string(100 + i);
+    LemmaKey key {"value_" + suffix, "lemma_" + suffix, "tag_" + suffix};
+    cache.find(key);
+    cache.find(key);
+    cache.insert(key, "lemma_" + suffix);
+  }
+
+  BOOST_TEST(cache.statistics().bytes <= budget);
+  BOOST_TEST(cache.statistics().evictions > 0u);
+}
+
+BOOST_AUTO_TEST_CASE(lemma_cache_does_not_let_one_off_key_evict_frequent_key)
+{
+  const LemmaKey frequentKey {"Kraków", "kraków", "subst:sg:nom:m3"};
+  const LemmaKey oneOffKey {"Pcim", "pcim", "subst:sg:nom:m3"};
+  LemmaCache cache(LemmaCache::entrySize(frequentKey, "kraków"), 1);
+
+  for (int i = 0; i < 5; ++i)
+    cache.find(frequentKey);
+  cache.insert(frequentKey, "kraków");
+
+  cache.find(oneOffKey);
+  cache.insert(oneOffKey, "pcim");
+
+  BOOST_TEST(cache.find(frequentKey).has_value());
+  BOOST_TEST(!cache.find(oneOffKey).has_value());
+  BOOST_CHECK_EQUAL(cache.statistics().rejections, 1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,160 @@
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <unistd.h>
+
+#include "../lemma_cache.h"
+#include "../lemma_store.h"
+
+namespace
+{
+
+const uint64_t fingerprint = 42;
+const uintmax_t maxFileBytes = 1024*1024;
+
+// A fresh store file, removed at the end of the test.
+struct StorePath
+{
+  StorePath()
+    : path(std::filesystem::temp_directory_path()
+           / ("lemma_store_tests_" + std::to_string(::getpid())))
+  {
+    std::filesystem::remove(path);
+  }
+  ~StorePath()
+  {
+    std::filesystem::remove(path);
+  }
+
+  std::filesystem::path path;
+};
+
+LemmaKey makeKey(int i)
+{
+  return {"Warszawy " + std::to_string(i), "warszawa", "subst:sg:gen:f"};
+}
+
+void writeEntries(const std::filesystem::path& path, int count)
+{
+  LemmaStore store(path, fingerprint, maxFileBytes);
+  for (int i = 0; i < count; ++i)
+    store.append(makeKey(i), "warszawa " + std::to_string(i));
+  store.flush();
+}
+
+size_t loadEntries(const std::filesystem::path& path, uint64_t storeFingerprint = fingerprint)
+{
+  LemmaStore store(path, storeFingerprint, maxFileBytes);
+  LemmaCache cache(1024*1024);
+  return store.loadInto(cache);
+}
+
+// Overwrites the byte `offsetFromEnd` bytes before the end of the file.
+void corruptByte(const std::filesystem::path& path, uintmax_t offsetFromEnd)
+{
+  std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekg(-static_cast<std::streamoff>(offsetFromEnd), std::ios::end);
+  const char byte = static_cast<char>(file.get());
+  file.seekp(-static_cast<std::streamoff>(offsetFromEnd), std::ios::end);
+  file.put(static_cast<char>(byte ^ 0x5a));
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(lemma_store_tests)
+
+BOOST_AUTO_TEST_CASE(lemma_store_restores_appended_entries)
+{
+  StorePath store;
+  writeEntries(store.path, 3);
+
+  LemmaStore reopened(store.path, fingerprint, maxFileBytes);
+  LemmaCache cache(1024*1024);
+  BOOST_CHECK_EQUAL(reopened.loadInto(cache), 3u);
+
+  const auto lemma = cache.find(makeKey(1));
+  BOOST_REQUIRE(lemma.has_value());
+  BOOST_CHECK_EQUAL(*lemma, "warszawa 1");
+}
+
+BOOST_AUTO_TEST_CASE(lemma_store_cuts_off_a_torn_tail)
+{
+  StorePath store;
+  writeEntries(store.path, 3);
+  const auto completeSize = std::filesystem::file_size(store.path);
+  std::filesystem::resize_file(store.path, completeSize - 5);
+
+  BOOST_CHECK_EQUAL(loadEntries(store.path), 2u);
+  BOOST_TEST(std::filesystem::file_size(store.path) < completeSize - 5);
+
+  // Appends go after the valid prefix, not behind the torn record.
+  {
+    LemmaStore reopened(store.path, fingerprint, maxFileBytes);
+    reopened.append(makeKey(7), "warszawa 7");
+    reopened.flush();
+  }
+  BOOST_CHECK_EQUAL(loadEntries(store.path), 3u);
+}
+
+BOOST_AUTO_TEST_CASE(lemma_store_drops_records_from_a_checksum_mismatch_on)
+{
+  StorePath store;
+  writeEntries(store.path, 3);
+  corruptByte(store.path, 2);
+
+  BOOST_CHECK_EQUAL(loadEntries(store.path), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(lemma_store_discards_a_file_of_other_dictionaries)
+{
+  StorePath store;
+  writeEntries(store.path, 3);
+
+  BOOST_CHECK_EQUAL(loadEntries(store.path, fingerprint + 1), 0u);
+  // Discarded for good: the file now belongs to the other dictionaries.
+  BOOST_CHECK_EQUAL(loadEntries(store.path), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(lemma_store_counts_only_the_entries_the_cache_takes)
+{
+  StorePath store;
+  writeEntries(store.path, 100);
+
+  LemmaStore reopened(store.path, fingerprint, maxFileBytes);
+  LemmaCache cache(16*LemmaCache::entrySize(makeKey(0), "warszawa 0"), 1);
+  const auto loadedEntries = reopened.loadInto(cache);
+
+  BOOST_TEST(loadedEntries < 100u);
+  BOOST_CHECK_EQUAL(loadedEntries, cache.statistics().entries);
+}
+
+BOOST_AUTO_TEST_CASE(lemma_store_compacts_from_the_cache_when_full)
+{
+  StorePath store;
+  const uintmax_t smallFileBytes = 4096;
+  auto cache = std::make_shared<LemmaCache>(1024*1024);
+  {
+    LemmaStore lemmaStore(store.path, fingerprint, smallFileBytes, cache);
+    // Every entry is appended over and over, as after repeated evictions.
+    for (int round = 0; round < 50; ++round)
+    {
+      for (int i = 0; i < 20; ++i)
+      {
+        cache->insert(makeKey(i), "warszawa " + std::to_string(i));
+        lemmaStore.append(makeKey(i), "warszawa " + std::to_string(i));
+      }
+      lemmaStore.flush();
+    }
+    BOOST_TEST(std::filesystem::file_size(store.path) <= smallFileBytes);
+  }
+
+  LemmaStore reopened(store.path, fingerprint, smallFileBytes);
+  LemmaCache restored(1024*1024);
+  BOOST_CHECK_EQUAL(reopened.loadInto(restored), 20u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
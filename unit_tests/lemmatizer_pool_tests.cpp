@@ -0,0 +1,63 @@
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+
+#include <polem-dev/CascadeLemmatizer.h>
+
+#include "../lemmatizer_pool.h"
+
+BOOST_AUTO_TEST_SUITE(lemmatizer_pool_tests)
+
+BOOST_AUTO_TEST_CASE(takes_a_released_lemmatizer_before_a_slow_assembly_finishes)
+{
+  std::promise<void> finishAssembly;
+  auto assemblyFinished = finishAssembly.get_future().share();
+  std::atomic<int> assemblies {0};
+  LemmatizerPool pool(2, 1, [&]
+  {
+    // The first lemmatizer is assembled at once, the second only when the test allows it.
+    if (assemblies++ > 0)
+      assemblyFinished.wait();
+    return std::make_unique<CascadeLemmatizer>();
+  });
+
+  auto first = std::make_unique<LemmatizerPool::Lease>(pool.acquire());
+  auto second = std::async(std::launch::async, [&pool]{ return pool.acquire().waitTime(); });
+  while (pool.statistics().waiting == 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  // The waiting request gets the released lemmatizer while the assembly is still running.
+  first.reset();
+  BOOST_TEST((second.wait_for(std::chrono::seconds(5)) == std::future_status::ready));
+  BOOST_CHECK_EQUAL(pool.statistics().size, 2);
+
+  finishAssembly.set_value();
+}
+
+BOOST_AUTO_TEST_CASE(assembles_up_to_the_capacity_in_the_background)
+{
+  LemmatizerPool pool(2, 0, []{ return std::make_unique<CascadeLemmatizer>(); });
+
+  auto first = pool.acquire();
+  auto second = pool.acquire();
+
+  const auto statistics = pool.statistics();
+  BOOST_CHECK_EQUAL(statistics.size, 2);
+  BOOST_CHECK_EQUAL(statistics.inUse, 2);
+}
+
+BOOST_AUTO_TEST_CASE(reports_a_failed_assembly_when_no_lemmatizer_is_left)
+{
+  LemmatizerPool pool(1, 0, []() -> std::unique_ptr<CascadeLemmatizer>
+  {
+    throw std::runtime_error("dictionaries missing");
+  });
+
+  BOOST_CHECK_THROW(pool.acquire(), std::runtime_error);
+  BOOST_CHECK_EQUAL(pool.statistics().size, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,153 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../request_head_filter.h"
+
+namespace
+{
+
+using Action = RequestHeadFilter::Action;
+
+RequestHeadFilter makeFilter()
+{
+  const auto maxBodyBytes = [](const RequestHead& head) -> size_t
+  {
+    return head.resource == "/uploads" ? 1000 : 100;
+  };
+  const auto validator = [](const RequestHead& head) -> std::optional<Rejection>
+  {
+    if (head.method != "POST")
+      return Rejection{400, "POST expected\n"};
+    return std::nullopt;
+  };
+  return RequestHeadFilter(1024, maxBodyBytes, validator);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(request_head_filter_tests)
+
+BOOST_AUTO_TEST_CASE(passes_requests_split_across_reads)
+{
+  auto filter = makeFilter();
+
+  BOOST_TEST((filter.consume("POST / HTTP/1.1\r\nContent-Le").action == Action::Pass));
+  BOOST_TEST((filter.consume("ngth: 4\r\n\r").action == Action::Pass));
+  BOOST_TEST((filter.consume("\n{}").action == Action::Pass));
+  // The rest of the body, then a pipelined request that is judged on its own.
+  auto verdict = filter.consume("{}GET / HTTP/1.1\r\n\r\n");
+  BOOST_TEST((verdict.action == Action::Reject));
+  // The end of the accepted body still goes to the parser.
+  BOOST_CHECK_EQUAL(verdict.passedBytes, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(passes_the_requests_pipelined_before_a_rejected_one)
+{
+  const std::string accepted = "POST / HTTP/1.1\r\nContent-Length: 2\r\n\r\n{}";
+
+  auto verdict = makeFilter().consume(accepted + "GET / HTTP/1.1\r\n\r\n");
+  BOOST_TEST((verdict.action == Action::Reject));
+  BOOST_CHECK_EQUAL(verdict.passedBytes, accepted.size());
+
+  auto filter = makeFilter();
+  BOOST_CHECK_EQUAL(filter.consume(accepted + "GET / HT").passedBytes, accepted.size() + 8);
+  // The rejected head started in earlier data, which has already been passed on.
+  verdict = filter.consume("TP/1.1\r\n\r\n");
+  BOOST_TEST((verdict.action == Action::Reject));
+  BOOST_CHECK_EQUAL(verdict.passedBytes, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_from_the_head_alone)
+{
+  auto filter = makeFilter();
+
+  auto verdict = filter.consume("GET /x?y=1 HTTP/1.1\r\nHost: a\r\n\r\n");
+
+  BOOST_TEST((verdict.action == Action::Reject));
+  BOOST_CHECK_EQUAL(verdict.rejection.statusCode, 400);
+  BOOST_CHECK_EQUAL(verdict.passedBytes, 0u);
+  BOOST_TEST((filter.consume("more bytes").action == Action::Discard));
+}
+
+BOOST_AUTO_TEST_CASE(rejects_bodies_over_the_limit_and_bad_lengths)
+{
+  auto tooLarge = makeFilter().consume("POST / HTTP/1.1\r\nContent-Length: 101\r\n\r\n");
+  BOOST_TEST((tooLarge.action == Action::Reject));
+  BOOST_CHECK_EQUAL(tooLarge.rejection.statusCode, 413);
+
+  auto largerLimit = makeFilter().consume("POST /uploads HTTP/1.1\r\nContent-Length: 101\r\n\r\n");
+  BOOST_TEST((largerLimit.action == Action::Pass));
+
+  auto invalid = makeFilter().consume("POST / HTTP/1.1\r\ncontent-length: -1\r\n\r\n");
+  BOOST_CHECK_EQUAL(invalid.rejection.statusCode, 400);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_oversized_heads)
+{
+  auto filter = makeFilter();
+
+  auto verdict = filter.consume("POST / HTTP/1.1\r\nX: " + std::string(2000, 'a'));
+
+  BOOST_TEST((verdict.action == Action::Reject));
+  BOOST_CHECK_EQUAL(verdict.rejection.statusCode, 431);
+}
+
+BOOST_AUTO_TEST_CASE(answers_expect_continue_only_for_acceptable_requests)
+{
+  auto accepted = makeFilter().consume(
+        "POST / HTTP/1.1\r\nContent-Length: 10\r\nEXPECT: 100-Continue\r\n\r\n");
+  BOOST_TEST((accepted.action == Action::PassAndContinue));
+
+  auto tooLarge = makeFilter().consume(
+        "POST / HTTP/1.1\r\nContent-Length: 1000\r\nExpect: 100-continue\r\n\r\n");
+  BOOST_TEST((tooLarge.action == Action::Reject));
+
+  auto unknown = makeFilter().consume("POST / HTTP/1.1\r\nExpect: something\r\n\r\n");
+  BOOST_CHECK_EQUAL(unknown.rejection.statusCode, 417);
+}
+
+BOOST_AUTO_TEST_CASE(follows_chunked_bodies_to_the_next_request)
+{
+  auto filter = makeFilter();
+
+  BOOST_TEST((filter.consume("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                             "3;name=value\r\nGET\r\n0").action == Action::Pass));
+  BOOST_TEST((filter.consume("\r\nTrailer: x\r\n\r").action == Action::Pass));
+  // The request after the body is judged like any other.
+  auto verdict = filter.consume("\nGET / HTTP/1.1\r\n\r\n");
+  BOOST_TEST((verdict.action == Action::Reject));
+  BOOST_CHECK_EQUAL(verdict.passedBytes, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(holds_chunked_bodies_to_the_resource_limit)
+{
+  const std::string chunked = " HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+  const std::string chunk = "32\r\n" + std::string(50, 'a') + "\r\n";
+
+  auto filter = makeFilter();
+  BOOST_TEST((filter.consume("POST /" + chunked + chunk + chunk).action == Action::Pass));
+  auto tooLarge = filter.consume("1\r\na\r\n");
+  BOOST_TEST((tooLarge.action == Action::Reject));
+  BOOST_CHECK_EQUAL(tooLarge.rejection.statusCode, 413);
+
+  auto larger = makeFilter().consume("POST /uploads" + chunked + chunk + chunk + chunk
+                                     + "0\r\n\r\n");
+  BOOST_TEST((larger.action == Action::Pass));
+
+  auto invalid = makeFilter().consume("POST /" + chunked + "x\r\n");
+  BOOST_CHECK_EQUAL(invalid.rejection.statusCode, 400);
+
+  auto notLast = makeFilter().consume(
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n");
+  BOOST_CHECK_EQUAL(notLast.rejection.statusCode, 400);
+}
+
+BOOST_AUTO_TEST_CASE(rejectionResponse_closes_the_connection)
+{
+  const auto response = RequestHeadFilter::rejectionResponse({413, "too large\n"});
+
+  BOOST_TEST(response.rfind("HTTP/1.1 413 Payload Too Large\r\n", 0) == 0);
+  BOOST_TEST(response.find("Content-Length: 10\r\n") != std::string::npos);
+  BOOST_TEST(response.find("Connection: close\r\n\r\ntoo large\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
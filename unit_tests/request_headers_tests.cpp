@@ -0,0 +1,60 @@
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+
+#include "../request_headers.h"
+#include "../wire_format.h"
+
+using namespace Pistache;
+
+namespace
+{
+
+Http::Header::Collection acceptHeaders(const std::string& value)
+{
+  auto accept = std::make_shared<Http::Header::Accept>();
+  accept->parse(value);
+  Http::Header::Collection headers;
+  headers.add(accept);
+  return headers;
+}
+
+// The response Content-Type the handler picks for these request headers.
+std::string responseContentType(const Http::Header::Collection& headers)
+{
+  return wire_format::mediaType(
+        wire_format::selectResponseFormat(request_headers::accept(headers, {"compact"})));
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(request_headers_tests)
+
+BOOST_AUTO_TEST_CASE(typed_accept_selects_the_response_content_type)
+{
+  BOOST_TEST(responseContentType(acceptHeaders("application/cbor")) == "application/cbor");
+  BOOST_TEST(responseContentType(acceptHeaders("application/json;q=0.5, application/x-msgpack"))
+             == "application/msgpack");
+  BOOST_TEST(responseContentType(acceptHeaders("application/json, application/cbor;q=0.9"))
+             == "application/json");
+}
+
+BOOST_AUTO_TEST_CASE(typed_accept_keeps_requested_parameters)
+{
+  const auto accept =
+      request_headers::accept(acceptHeaders("application/json; compact=1"), {"compact"});
+
+  BOOST_TEST(accept == "application/json; compact=1");
+}
+
+BOOST_AUTO_TEST_CASE(raw_accept_is_used_when_not_typed)
+{
+  Http::Header::Collection headers;
+  headers.addRaw(Http::Header::Raw("accept", "application/cbor"));
+
+  BOOST_TEST(responseContentType(headers) == "application/cbor");
+  BOOST_TEST(request_headers::find(headers, "Accept").value_or("") == "application/cbor");
+  BOOST_TEST(!request_headers::find(headers, "Accept-Encoding"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
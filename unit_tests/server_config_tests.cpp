@@ -0,0 +1,139 @@
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../server_config.h"
+
+namespace
+{
+
+// A fresh directory, removed with everything in it at the end of the test.
+struct TemporaryDirectory
+{
+  TemporaryDirectory()
+    : path(std::filesystem::temp_directory_path()
+           / ("server_config_tests_" + std::to_string(::getpid())))
+  {
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+  }
+  ~TemporaryDirectory()
+  {
+    std::filesystem::remove_all(path);
+  }
+
+  void write(const std::filesystem::path& file, const std::string& content) const
+  {
+    std::filesystem::create_directories((path / file).parent_path());
+    std::ofstream(path / file) << content;
+  }
+
+  std::filesystem::path path;
+};
+
+ServerConfig parse(std::vector<std::string> arguments)
+{
+  arguments.insert(arguments.begin(), "polem-microservice");
+  std::vector<char*> argv;
+  for (auto& argument : arguments)
+    argv.push_back(argument.data());
+  return server_config::parseCommandLine(static_cast<int>(argv.size()), argv.data());
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(server_config_tests)
+
+BOOST_AUTO_TEST_CASE(parses_command_line_options)
+{
+  const auto config = parse({"--port", "8080", "--max-request-bytes", "2048",
+                             "--warmup-corpus", "a.jsonl", "--warmup-corpus", "b.jsonl"});
+
+  BOOST_CHECK_EQUAL(config.port, 8080);
+  BOOST_CHECK_EQUAL(config.maxRequestBytes, 2048u);
+  BOOST_REQUIRE_EQUAL(config.warmupCorpusPaths.size(), 2u);
+  BOOST_CHECK_EQUAL(config.warmupCorpusPaths[1], "b.jsonl");
+}
+
+BOOST_AUTO_TEST_CASE(rejects_invalid_options)
+{
+  BOOST_CHECK_THROW(parse({"--port", "70000"}), std::invalid_argument);
+  BOOST_CHECK_THROW(parse({"--threads", "-1"}), std::invalid_argument);
+  BOOST_CHECK_THROW(parse({"--gzip-level", "10"}), std::invalid_argument);
+  BOOST_CHECK_THROW(parse({"--no-such-option", "1"}), std::invalid_argument);
+  BOOST_CHECK_THROW(parse({"--port"}), std::invalid_argument);
+  BOOST_CHECK_THROW(parse({"--port", "0"}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(command_line_overrides_the_config_file)
+{
+  TemporaryDirectory directory;
+  directory.write("config.json", R"({"port": 6000, "threads": 3, "dictionary-version": "v1",
+                                     "warmup-corpus": ["a.jsonl", "b.jsonl"],
+                                     "prefetch-dictionaries": ["dictionaries"]})");
+
+  const auto configPath = (directory.path / "config.json").string();
+  const auto config = parse({"--threads", "5", "--config", configPath,
+                             "--warmup-corpus", "c.jsonl"});
+
+  BOOST_CHECK_EQUAL(config.port, 6000);
+  BOOST_CHECK_EQUAL(config.threadCount, 5u);
+  BOOST_CHECK_EQUAL(config.dictionaryVersion, "v1");
+  // Lists given on the command line replace the file's, the others are kept.
+  BOOST_REQUIRE_EQUAL(config.warmupCorpusPaths.size(), 1u);
+  BOOST_CHECK_EQUAL(config.warmupCorpusPaths[0], "c.jsonl");
+  BOOST_REQUIRE_EQUAL(config.dictionaryPrefetchPaths.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_invalid_config_files)
+{
+  TemporaryDirectory directory;
+  directory.write("array.json", "[1, 2]");
+  directory.write("negative.json", R"({"port": -1})");
+
+  BOOST_CHECK_THROW(parse({"--config", (directory.path / "array.json").string()}),
+                    std::invalid_argument);
+  BOOST_CHECK_THROW(parse({"--config", (directory.path / "negative.json").string()}),
+                    std::invalid_argument);
+  BOOST_CHECK_THROW(parse({"--config", (directory.path / "missing.json").string()}),
+                    std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(reads_the_cgroup_v2_cpu_limit)
+{
+  TemporaryDirectory directory;
+  directory.write("cpu.max", "150000 100000\n");
+  const auto limit = server_config::readCgroupCpuLimit(directory.path);
+  BOOST_REQUIRE(limit.has_value());
+  BOOST_CHECK_CLOSE(*limit, 1.5, 0.001);
+
+  directory.write("cpu.max", "max 100000\n");
+  BOOST_TEST(!server_config::readCgroupCpuLimit(directory.path).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(reads_the_cgroup_v1_cpu_limit)
+{
+  TemporaryDirectory directory;
+  directory.write("cpu/cpu.cfs_quota_us", "200000\n");
+  directory.write("cpu/cpu.cfs_period_us", "100000\n");
+  const auto limit = server_config::readCgroupCpuLimit(directory.path);
+  BOOST_REQUIRE(limit.has_value());
+  BOOST_CHECK_CLOSE(*limit, 2.0, 0.001);
+
+  directory.write("cpu/cpu.cfs_quota_us", "-1\n");
+  BOOST_TEST(!server_config::readCgroupCpuLimit(directory.path).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(reads_no_cpu_limit_without_a_cgroup)
+{
+  TemporaryDirectory directory;
+  BOOST_TEST(!server_config::readCgroupCpuLimit(directory.path).has_value());
+  BOOST_TEST(server_config::availableCpuCount() >= 1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -13,11 +13,54 @@ isEmpty(BOOST_INCLUDE_DIR): {
 }
 
 SOURCES += \
+  admission_controller_tests.cpp \
+  body_codec_tests.cpp \
+  content_negotiation_tests.cpp \
+  job_manager_tests.cpp \
+  json_output_tests.cpp \
   json_prasing_tests.cpp \
+  lemma_cache_tests.cpp \
+  lemma_store_tests.cpp \
+  lemmatizer_pool_tests.cpp \
+  request_head_filter_tests.cpp \
+  request_headers_tests.cpp \
+  server_config_tests.cpp \
+  wire_format_tests.cpp \
+  work_stealing_pool_tests.cpp \
+  ../admission_controller.cpp \
+  ../body_codec.cpp \
+  ../content_negotiation.cpp \
+  ../job_manager.cpp \
+  ../json_output.cpp \
   ../label_processing.cpp \
+  ../lemma_cache.cpp \
+  ../lemma_store.cpp \
+  ../lemmatizer_pool.cpp \
+  ../ndjson_processing.cpp \
+  ../request_head_filter.cpp \
+  ../request_headers.cpp \
+  ../server_config.cpp \
+  ../service_state.cpp \
+  ../wire_format.cpp \
+  ../work_stealing_pool.cpp \
 
 HEADERS += \
-  ../label_processing.h
+  ../admission_controller.h \
+  ../body_codec.h \
+  ../content_negotiation.h \
+  ../job_manager.h \
+  ../json_output.h \
+  ../label_processing.h \
+  ../lemma_cache.h \
+  ../lemma_store.h \
+  ../lemmatizer_pool.h \
+  ../ndjson_processing.h \
+  ../request_head_filter.h \
+  ../request_headers.h \
+  ../server_config.h \
+  ../service_state.h \
+  ../wire_format.h \
+  ../work_stealing_pool.h
 
 unix: LIBS += -L$$PWD/../../../../usr/local/lib/ -lpolem-dev
 
@@ -25,3 +68,14 @@ INCLUDEPATH += $$PWD/../../../../usr/local/include
 DEPENDPATH += $$PWD/../../../../usr/local/include
 
 unix:!macx: LIBS += -licuuc
+
+INCLUDEPATH += $$PWD/../../../../usr/include/pistache
+DEPENDPATH += $$PWD/../../../../usr/include/pistache
+unix: LIBS += -L$$PWD/../../../../usr/lib/x86_64-linux-gnu/ -lpistache
+
+unix: LIBS += -lpthread -lz
+
+with_zstd {
+  DEFINES += WITH_ZSTD
+  LIBS += -lzstd
+}
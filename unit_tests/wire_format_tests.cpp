@@ -0,0 +1,34 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../wire_format.h"
+
+using Json = nlohmann::json;
+using wire_format::WireFormat;
+
+BOOST_AUTO_TEST_SUITE(wire_format_tests)
+
+BOOST_AUTO_TEST_CASE(selectResponseFormat_prefers_the_highest_quality_supported_type)
+{
+  BOOST_TEST((wire_format::selectResponseFormat("application/cbor") == WireFormat::Cbor));
+  BOOST_TEST((wire_format::selectResponseFormat("application/json;q=0.5, application/x-msgpack")
+              == WireFormat::MessagePack));
+  BOOST_TEST((wire_format::selectResponseFormat("application/json, application/cbor")
+              == WireFormat::Json));
+  BOOST_TEST((wire_format::selectResponseFormat("*/*") == WireFormat::Json));
+  BOOST_TEST((wire_format::selectResponseFormat("") == WireFormat::Json));
+}
+
+BOOST_AUTO_TEST_CASE(parse_reads_every_format)
+{
+  const auto json = R"({"docs": [{"labels": [{"value": "Alejach Jerozolimskich"}]}]})"_json;
+  const auto cbor = Json::to_cbor(json);
+  const auto messagePack = Json::to_msgpack(json);
+
+  BOOST_TEST(wire_format::parse(json.dump(), WireFormat::Json) == json);
+  BOOST_TEST(wire_format::parse(std::string(cbor.begin(), cbor.end()), WireFormat::Cbor) == json);
+  BOOST_TEST(wire_format::parse(std::string(messagePack.begin(), messagePack.end()),
+                                WireFormat::MessagePack) == json);
+  BOOST_CHECK_THROW(wire_format::parse("{}", WireFormat::Cbor), Json::parse_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <future>
+
+#include "../work_stealing_pool.h"
+
+BOOST_AUTO_TEST_SUITE(work_stealing_pool_tests)
+
+BOOST_AUTO_TEST_CASE(work_stealing_pool_runs_every_submitted_task)
+{
+  std::atomic<int> completedTasks {0};
+  {
+    WorkStealingPool pool(4);
+    for (int i = 0; i < 1000; ++i)
+      pool.submit([&completedTasks]{ ++completedTasks; });
+  }
+
+  BOOST_CHECK_EQUAL(completedTasks.load(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(work_stealing_pool_steals_from_a_busy_worker)
+{
+  WorkStealingPool pool(2);
+  std::promise<void> release;
+  auto released = release.get_future().share();
+
+  // Submitted from a worker, both follow-up tasks land on the blocked worker's own queue;
+  // they can only complete if the other worker steals them.
+  std::promise<void> followUpsDone;
+  std::atomic<int> followUps {0};
+  pool.submit([&]
+  {
+    for (int i = 0; i < 2; ++i)
+    {
+      pool.submit([&]
+      {
+        if (++followUps == 2)
+          followUpsDone.set_value();
+      });
+    }
+    released.wait();
+  });
+
+  const auto status = followUpsDone.get_future().wait_for(std::chrono::seconds(5));
+  release.set_value();
+
+  BOOST_REQUIRE(status == std::future_status::ready);
+  BOOST_TEST(pool.statistics().stolen >= 2u);
+}
+
+BOOST_AUTO_TEST_CASE(work_stealing_pool_survives_a_throwing_task)
+{
+  WorkStealingPool pool(1);
+  std::promise<void> done;
+  pool.submit([]{ throw std::runtime_error("failed"); });
+  pool.submit([&done]{ done.set_value(); });
+
+  BOOST_TEST((done.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready));
+}
+
+BOOST_AUTO_TEST_CASE(work_stealing_pool_rejects_zero_threads)
+{
+  BOOST_CHECK_THROW(WorkStealingPool(0), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,76 @@
+#include "wire_format.h"
+
+#include "content_negotiation.h"
+
+using Json = nlohmann::json;
+
+namespace wire_format
+{
+
+namespace
+{
+
+const std::string jsonMediaType = "application/json";
+const std::string cborMediaType = "application/cbor";
+const std::string messagePackMediaType = "application/msgpack";
+
+}
+
+std::optional<WireFormat> fromMediaType(const std::string& mediaType)
+{
+  if (mediaType == jsonMediaType)
+    return WireFormat::Json;
+  if (mediaType == cborMediaType)
+    return WireFormat::Cbor;
+  // MessagePack has no registered media type; these are the names in use.
+  if (mediaType == messagePackMediaType
+      || mediaType == "application/x-msgpack"
+      || mediaType == "application/vnd.msgpack")
+    return WireFormat::MessagePack;
+  return std::nullopt;
+}
+
+std::string mediaType(WireFormat format)
+{
+  switch (format)
+  {
+    case WireFormat::Cbor:
+      return cborMediaType;
+    case WireFormat::MessagePack:
+      return messagePackMediaType;
+    default:
+      return jsonMediaType;
+  }
+}
+
+WireFormat selectResponseFormat(const std::string& accept)
+{
+  // Wildcards don't change the default: a client that takes anything gets JSON.
+  WireFormat selected = WireFormat::Json;
+  double selectedQuality = 0.0;
+  for (const auto& entry : content_negotiation::parseAcceptList(accept))
+  {
+    const auto format = fromMediaType(entry.value);
+    if (format && entry.quality > selectedQuality)
+    {
+      selected = *format;
+      selectedQuality = entry.quality;
+    }
+  }
+  return selected;
+}
+
+Json parse(const std::string& body, WireFormat format)
+{
+  switch (format)
+  {
+    case WireFormat::Cbor:
+      return Json::from_cbor(body);
+    case WireFormat::MessagePack:
+      return Json::from_msgpack(body);
+    default:
+      return Json::parse(body);
+  }
+}
+
+}
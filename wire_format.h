@@ -0,0 +1,34 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <optional>
+#include <string>
+
+#include "nlohmann_json/json.hpp"
+
+// Encodings of request and response bodies: text JSON, or the same document model in CBOR or
+// MessagePack, which parse and serialise faster and are smaller on the wire.
+namespace wire_format
+{
+
+enum class WireFormat
+{
+  Json,
+  Cbor,
+  MessagePack
+};
+
+// Format of a media type such as "application/cbor" (lowercase, without parameters);
+// std::nullopt if it isn't one of the supported ones.
+std::optional<WireFormat> fromMediaType(const std::string& mediaType);
+std::string mediaType(WireFormat format);
+
+// The format the Accept header value prefers; JSON if it's empty or allows none of them.
+WireFormat selectResponseFormat(const std::string& accept);
+
+// Throws nlohmann::json::parse_error if the body isn't valid in the given format.
+nlohmann::json parse(const std::string& body, WireFormat format);
+
+}
+
+#endif // WIRE_FORMAT_H
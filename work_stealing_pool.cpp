@@ -0,0 +1,144 @@
+#include "work_stealing_pool.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local size_t currentWorkerIndex = 0;
+
+}
+
+WorkStealingPool::WorkStealingPool(size_t threadCount)
+{
+  if (threadCount == 0)
+    throw std::invalid_argument("Work-stealing pool needs at least one thread");
+
+  for (size_t i = 0; i < threadCount; ++i)
+    queues_.push_back(std::make_unique<WorkerQueue>());
+
+  for (size_t i = 0; i < threadCount; ++i)
+    workers_.emplace_back([this, i]{ runWorker(i); });
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(idleMutex_);
+    stopping_ = true;
+  }
+  workAvailable_.notify_all();
+
+  for (auto& worker : workers_)
+    worker.join();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+  const size_t queueIndex = currentPool == this
+      ? currentWorkerIndex
+      : nextQueue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+  {
+    auto& queue = *queues_[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  ++submitted_;
+
+  {
+    std::lock_guard<std::mutex> lock(idleMutex_);
+    ++pending_;
+  }
+  workAvailable_.notify_one();
+}
+
+WorkStealingPool::Statistics WorkStealingPool::statistics() const
+{
+  Statistics statistics;
+  statistics.threadCount = workers_.size();
+  {
+    std::lock_guard<std::mutex> lock(idleMutex_);
+    statistics.queued = pending_ > 0 ? static_cast<size_t>(pending_) : 0;
+  }
+  statistics.running = running_;
+  statistics.submitted = submitted_;
+  statistics.completed = completed_;
+  statistics.stolen = stolen_;
+  return statistics;
+}
+
+void WorkStealingPool::runWorker(size_t workerIndex)
+{
+  currentPool = this;
+  currentWorkerIndex = workerIndex;
+
+  for (;;)
+  {
+    Task task;
+    if (takeTask(workerIndex, task))
+    {
+      ++running_;
+      try
+      {
+        task();
+      }
+      catch (const std::exception& exception)
+      {
+        std::cout << "> Compute task failed: " << exception.what() << "\n";
+      }
+      --running_;
+      ++completed_;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(idleMutex_);
+    workAvailable_.wait(lock, [this]{ return stopping_ || pending_ > 0; });
+    if (stopping_ && pending_ <= 0)
+      return;
+  }
+}
+
+bool WorkStealingPool::takeTask(size_t workerIndex, Task& task)
+{
+  if (!popOwnTask(workerIndex, task) && !stealTask(workerIndex, task))
+    return false;
+
+  std::lock_guard<std::mutex> lock(idleMutex_);
+  --pending_;
+  return true;
+}
+
+bool WorkStealingPool::popOwnTask(size_t workerIndex, Task& task)
+{
+  // Oldest first rather than the usual LIFO: the tasks are requests, and a burst must not
+  // starve the ones that arrived before it.
+  auto& queue = *queues_[workerIndex];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty())
+    return false;
+
+  task = std::move(queue.tasks.front());
+  queue.tasks.pop_front();
+  return true;
+}
+
+bool WorkStealingPool::stealTask(size_t workerIndex, Task& task)
+{
+  // Also the oldest task of a victim: it's the one that has waited longest behind a long job.
+  for (size_t offset = 1; offset < queues_.size(); ++offset)
+  {
+    auto& queue = *queues_[(workerIndex + offset) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    ++stolen_;
+    return true;
+  }
+  return false;
+}
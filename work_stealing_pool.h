@@ -0,0 +1,70 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for CPU-bound jobs, so that they don't run on the server's I/O
+// threads. Every worker has its own queue; tasks submitted from outside are spread round-robin,
+// tasks submitted by a worker go to its own queue, and an idle worker steals from the others.
+class WorkStealingPool
+{
+public:
+  using Task = std::function<void()>;
+
+  struct Statistics
+  {
+    size_t threadCount = 0;
+    size_t queued = 0;
+    size_t running = 0;
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t stolen = 0;
+  };
+
+  explicit WorkStealingPool(size_t threadCount);
+  // Runs the tasks that are still queued, then joins the workers.
+  ~WorkStealingPool();
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  void submit(Task task);
+  Statistics statistics() const;
+
+private:
+  struct WorkerQueue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void runWorker(size_t workerIndex);
+  bool takeTask(size_t workerIndex, Task& task);
+  bool popOwnTask(size_t workerIndex, Task& task);
+  bool stealTask(size_t workerIndex, Task& task);
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<size_t> nextQueue_ {0};
+
+  mutable std::mutex idleMutex_;
+  std::condition_variable workAvailable_;
+  // Tasks pushed but not yet taken; may dip below zero for a moment, when a worker takes a task
+  // before its submitter has counted it.
+  int64_t pending_ = 0;
+  bool stopping_ = false;
+
+  std::atomic<size_t> running_ {0};
+  std::atomic<uint64_t> submitted_ {0};
+  std::atomic<uint64_t> completed_ {0};
+  std::atomic<uint64_t> stolen_ {0};
+};
+
+#endif // WORK_STEALING_POOL_H